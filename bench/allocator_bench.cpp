@@ -0,0 +1,263 @@
+// Allocator benchmark: runs synthetic workloads against every strategy and
+// prints one result row per (workload, free order, live set, strategy).
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -o allocator_bench bench/allocator_bench.cpp src/memory.cpp
+//       src/allocator.cpp src/address_index.cpp src/buddy.cpp src/tlsf.cpp
+//       src/slab.cpp src/block_table.cpp
+//
+// Usage:
+//   allocator_bench [--live 1000,10000] [--ops 200000] [--heap 67108864]
+//                   [--seed 42] [--format csv|json]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/memory.h"
+#include "../include/allocator.h"
+
+enum SizeDistribution {
+    UNIFORM,        // 16 .. 4096 bytes
+    POWER_LAW,      // Pareto, alpha 1.5, 16 .. 65536 bytes
+    BIMODAL         // 90% 16 .. 64 bytes, 10% 16 KB .. 64 KB
+};
+
+enum FreeOrder {
+    LIFO,           // free the most recent allocation
+    RANDOM_ORDER    // free a random live allocation
+};
+
+struct BenchConfig {
+    std::vector<int> liveSets;
+    int ops;
+    MemSize heapSize;
+    unsigned long long seed;
+    bool json;
+};
+
+struct BenchResult {
+    std::string workload;
+    std::string freeOrder;
+    std::string strategy;
+    int liveSet;
+    int ops;
+    double nsPerOp;
+    long long p50;
+    long long p99;
+    int peakBlocks;
+    int failures;
+    MemoryStats finalStats;
+};
+
+static const char *distributionName(SizeDistribution d) {
+    if (d == UNIFORM) return "uniform";
+    if (d == POWER_LAW) return "power_law";
+    return "bimodal";
+}
+
+static int nextSize(SizeDistribution d, std::mt19937_64 &rng) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    if (d == UNIFORM)
+        return std::uniform_int_distribution<int>(16, 4096)(rng);
+
+    if (d == POWER_LAW) {
+        double u = 1.0 - unit(rng);     // (0, 1]
+        double size = 16.0 / std::pow(u, 1.0 / 1.5);
+        return (int)std::min(size, 65536.0);
+    }
+
+    if (unit(rng) < 0.9)
+        return std::uniform_int_distribution<int>(16, 64)(rng);
+    return std::uniform_int_distribution<int>(16 * 1024, 64 * 1024)(rng);
+}
+
+static long long percentile(std::vector<long long> &samples, double p) {
+    if (samples.empty())
+        return 0;
+
+    size_t k = (size_t)(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+static BenchResult runOne(const BenchConfig &config, SizeDistribution dist, FreeOrder order,
+                          int liveSet, AllocatorType strategy) {
+    typedef std::chrono::steady_clock Clock;
+
+    Memory mem;
+    Allocator alloc;
+    mem.init(config.heapSize);
+    alloc.setAllocator(strategy);
+
+    // Same seed for every strategy, so they all see the same request stream
+    std::mt19937_64 rng(config.seed);
+    std::vector<int> live;
+    live.reserve(liveSet);
+
+    BenchResult result;
+    result.workload = distributionName(dist);
+    result.freeOrder = order == LIFO ? "lifo" : "random";
+    result.strategy = allocatorTypeName(strategy);
+    result.liveSet = liveSet;
+    result.ops = 0;
+    result.peakBlocks = 0;
+    result.failures = 0;
+
+    // Warm up to the live set size
+    for (int i = 0; i < liveSet; i++) {
+        AllocResult r = alloc.allocate(mem, nextSize(dist, rng));
+        if (r.failure == ALLOC_OK)
+            live.push_back(r.id);
+        else
+            result.failures++;
+    }
+
+    std::vector<long long> latencies;
+    latencies.reserve(config.ops);
+    long long totalNs = 0;
+
+    // Steady state: alternate free and malloc to hold the live set
+    for (int i = 0; i < config.ops; i++) {
+        bool doFree = (i % 2 == 0) && !live.empty();
+        int size = doFree ? 0 : nextSize(dist, rng);
+        size_t victim = 0;
+
+        if (doFree) {
+            victim = order == LIFO
+                ? live.size() - 1
+                : std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+        }
+
+        Clock::time_point begin = Clock::now();
+        AllocResult r;
+        if (doFree)
+            alloc.release(mem, live[victim]);
+        else
+            r = alloc.allocate(mem, size);
+        Clock::time_point end = Clock::now();
+
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+        latencies.push_back(ns);
+        totalNs += ns;
+
+        if (doFree) {
+            live[victim] = live.back();
+            live.pop_back();
+        } else if (r.failure == ALLOC_OK) {
+            live.push_back(r.id);
+        } else {
+            result.failures++;
+        }
+
+        int blocks = mem.getBlocks().size();
+        if (blocks > result.peakBlocks)
+            result.peakBlocks = blocks;
+    }
+
+    result.ops = config.ops;
+    result.nsPerOp = config.ops > 0 ? (double)totalNs / config.ops : 0.0;
+    result.p50 = percentile(latencies, 0.50);
+    result.p99 = percentile(latencies, 0.99);
+    result.finalStats = mem.getStats();
+    return result;
+}
+
+static void printCsvHeader() {
+    std::cout << "workload,free_order,live_set,strategy,ops,ns_per_op,p50_ns,p99_ns,"
+              << "peak_blocks,failures,utilization_pct,external_frag_pct,internal_frag_pct\n";
+}
+
+static void printCsv(const BenchResult &r) {
+    std::cout << r.workload << "," << r.freeOrder << "," << r.liveSet << ","
+              << r.strategy << "," << r.ops << "," << r.nsPerOp << ","
+              << r.p50 << "," << r.p99 << "," << r.peakBlocks << ","
+              << r.failures << "," << r.finalStats.utilization << ","
+              << r.finalStats.externalFragmentation << ","
+              << r.finalStats.internalFragmentation << "\n";
+}
+
+static void printJson(const BenchResult &r, bool last) {
+    std::cout << "  {\"workload\": \"" << r.workload << "\""
+              << ", \"free_order\": \"" << r.freeOrder << "\""
+              << ", \"live_set\": " << r.liveSet
+              << ", \"strategy\": \"" << r.strategy << "\""
+              << ", \"ops\": " << r.ops
+              << ", \"ns_per_op\": " << r.nsPerOp
+              << ", \"p50_ns\": " << r.p50
+              << ", \"p99_ns\": " << r.p99
+              << ", \"peak_blocks\": " << r.peakBlocks
+              << ", \"failures\": " << r.failures
+              << ", \"utilization_pct\": " << r.finalStats.utilization
+              << ", \"external_frag_pct\": " << r.finalStats.externalFragmentation
+              << ", \"internal_frag_pct\": " << r.finalStats.internalFragmentation
+              << "}" << (last ? "\n" : ",\n");
+}
+
+static std::vector<int> parseList(const std::string &text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (getline(ss, item, ','))
+        values.push_back(std::stoi(item));
+    return values;
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+    config.liveSets = {1000, 10000};
+    config.ops = 200000;
+    config.heapSize = 64 * 1024 * 1024;
+    config.seed = 42;
+    config.json = false;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+
+        if (arg == "--live")
+            config.liveSets = parseList(value);
+        else if (arg == "--ops")
+            config.ops = std::stoi(value);
+        else if (arg == "--heap")
+            config.heapSize = std::stoll(value);
+        else if (arg == "--seed")
+            config.seed = std::stoull(value);
+        else if (arg == "--format")
+            config.json = value == "json";
+        else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    const SizeDistribution dists[] = {UNIFORM, POWER_LAW, BIMODAL};
+    const FreeOrder orders[] = {LIFO, RANDOM_ORDER};
+    const AllocatorType strategies[] = {FIRST_FIT, BEST_FIT, WORST_FIT, BUDDY, TLSF};
+
+    std::vector<BenchResult> results;
+    for (SizeDistribution dist : dists)
+        for (FreeOrder order : orders)
+            for (int liveSet : config.liveSets)
+                for (AllocatorType strategy : strategies)
+                    results.push_back(runOne(config, dist, order, liveSet, strategy));
+
+    if (config.json) {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++)
+            printJson(results[i], i + 1 == results.size());
+        std::cout << "]\n";
+    } else {
+        printCsvHeader();
+        for (const BenchResult &r : results)
+            printCsv(r);
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Cache benchmark: replays a synthetic address stream through get() and
+// through getBatch(), checks both give the same counters, and prints one
+// result row per access pattern.
+//
+// Build from the repository root (add -mavx2 for the AVX2 tag compare):
+//   g++ -std=c++17 -O2 -o cache_bench bench/cache_bench.cpp src/cache.cpp
+//       src/cache_policy.cpp src/prefetch.cpp
+//
+// Usage:
+//   cache_bench [--l1 64x8x64] [--l2 512x8x64] [--policy lru]
+//               [--prefetch next-line|stride|stream] [--accesses 10000000]
+//               [--seed 42] [--format csv|json]
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/cache.h"
+
+enum AccessPattern {
+    SEQUENTIAL,     // 4-byte stride over a 4 MB array
+    LOOP,           // repeated passes over a 48 KB array
+    RANDOM_ACCESS   // uniform over 16 MB
+};
+
+struct BenchResult {
+    std::string pattern;
+    long long accesses;
+    double scalarNs;
+    double batchNs;
+    bool countersMatch;
+    CacheStats stats;
+};
+
+static const char *patternName(AccessPattern p) {
+    if (p == SEQUENTIAL) return "sequential";
+    if (p == LOOP) return "loop";
+    return "random";
+}
+
+static std::vector<MemAddr> makeTrace(AccessPattern pattern, long long n, unsigned long long seed) {
+    std::vector<MemAddr> addrs(n);
+    std::mt19937_64 rng(seed);
+
+    for (long long i = 0; i < n; i++) {
+        if (pattern == SEQUENTIAL)
+            addrs[i] = (i * 4) % (4 << 20);
+        else if (pattern == LOOP)
+            addrs[i] = (i * 4) % (48 << 10);
+        else
+            addrs[i] = (MemAddr)(rng() % (16 << 20));
+    }
+    return addrs;
+}
+
+static bool sameCounters(const CacheStats &a, const CacheStats &b) {
+    return a.l1Hits == b.l1Hits && a.l1Misses == b.l1Misses &&
+           a.l2Hits == b.l2Hits && a.l2Misses == b.l2Misses &&
+           a.memoryAccesses == b.memoryAccesses &&
+           a.l1Types.compulsory == b.l1Types.compulsory &&
+           a.l1Types.capacity == b.l1Types.capacity &&
+           a.l1Types.conflict == b.l1Types.conflict &&
+           a.l2Types.compulsory == b.l2Types.compulsory &&
+           a.l2Types.capacity == b.l2Types.capacity &&
+           a.l2Types.conflict == b.l2Types.conflict &&
+           a.memoryReads == b.memoryReads && a.memoryWrites == b.memoryWrites &&
+           a.bytesRead == b.bytesRead && a.bytesWritten == b.bytesWritten &&
+           a.prefetchesIssued == b.prefetchesIssued &&
+           a.usefulPrefetches == b.usefulPrefetches &&
+           a.pollutionMisses == b.pollutionMisses;
+}
+
+static BenchResult runOne(const CacheConfig &config, AccessPattern pattern,
+                          long long accesses, unsigned long long seed) {
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<MemAddr> addrs = makeTrace(pattern, accesses, seed);
+    std::vector<CacheResult> results(addrs.size());
+
+    TwoLevelCache scalar(config);
+    Clock::time_point begin = Clock::now();
+    long long checksum = 0;
+    for (MemAddr addr : addrs)
+        checksum += scalar.get(addr);
+    Clock::time_point mid = Clock::now();
+
+    TwoLevelCache batched(config);
+    Clock::time_point batchBegin = Clock::now();
+    batched.getBatch(addrs.data(), addrs.size(), results.data());
+    Clock::time_point end = Clock::now();
+
+    long long batchChecksum = 0;
+    for (const CacheResult &r : results)
+        batchChecksum += r.value;
+
+    BenchResult result;
+    result.pattern = patternName(pattern);
+    result.accesses = accesses;
+    result.scalarNs = std::chrono::duration<double, std::nano>(mid - begin).count() / accesses;
+    result.batchNs = std::chrono::duration<double, std::nano>(end - batchBegin).count() / accesses;
+    result.stats = batched.getStats();
+    result.countersMatch = sameCounters(scalar.getStats(), result.stats) &&
+                           checksum == batchChecksum;
+    return result;
+}
+
+static void printCsv(const BenchResult &r) {
+    std::cout << r.pattern << "," << r.accesses << "," << r.scalarNs << ","
+              << r.batchNs << "," << (r.countersMatch ? "yes" : "no") << ","
+              << r.stats.l1Hits << "," << r.stats.l1Misses << ","
+              << r.stats.l2Hits << "," << r.stats.l2Misses << ","
+              << r.stats.l1Types.conflict << "," << r.stats.l2Types.conflict << ","
+              << r.stats.memoryReads << "," << r.stats.prefetchesIssued << ","
+              << r.stats.usefulPrefetches << "," << r.stats.pollutionMisses << "\n";
+}
+
+static void printJson(const BenchResult &r, bool last) {
+    std::cout << "  {\"pattern\": \"" << r.pattern << "\""
+              << ", \"accesses\": " << r.accesses
+              << ", \"scalar_ns\": " << r.scalarNs
+              << ", \"batch_ns\": " << r.batchNs
+              << ", \"counters_match\": " << (r.countersMatch ? "true" : "false")
+              << ", \"l1_hits\": " << r.stats.l1Hits
+              << ", \"l1_misses\": " << r.stats.l1Misses
+              << ", \"l2_hits\": " << r.stats.l2Hits
+              << ", \"l2_misses\": " << r.stats.l2Misses
+              << ", \"l1_conflict\": " << r.stats.l1Types.conflict
+              << ", \"l2_conflict\": " << r.stats.l2Types.conflict
+              << ", \"memory_reads\": " << r.stats.memoryReads
+              << ", \"prefetches\": " << r.stats.prefetchesIssued
+              << ", \"useful_prefetches\": " << r.stats.usefulPrefetches
+              << ", \"pollution\": " << r.stats.pollutionMisses
+              << "}" << (last ? "\n" : ",\n");
+}
+
+int main(int argc, char *argv[]) {
+    std::string l1 = "64x8x64", l2 = "512x8x64", policy = "lru", prefetch;
+    long long accesses = 10000000;
+    unsigned long long seed = 42;
+    bool json = false;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+
+        if (arg == "--l1")
+            l1 = value;
+        else if (arg == "--l2")
+            l2 = value;
+        else if (arg == "--policy")
+            policy = value;
+        else if (arg == "--prefetch")
+            prefetch = value;
+        else if (arg == "--accesses")
+            accesses = std::stoll(value);
+        else if (arg == "--seed")
+            seed = std::stoull(value);
+        else if (arg == "--format")
+            json = value == "json";
+        else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    CacheConfig config;
+    std::string error;
+    std::stringstream args(l1 + " " + l2 + " " + policy + " " + prefetch);
+    if (!parseCacheConfig(args, config, error) || accesses <= 0) {
+        std::cerr << (error.empty() ? "Invalid access count" : error) << "\n";
+        return 1;
+    }
+
+    const AccessPattern patterns[] = {SEQUENTIAL, LOOP, RANDOM_ACCESS};
+    std::vector<BenchResult> results;
+    for (AccessPattern p : patterns)
+        results.push_back(runOne(config, p, accesses, seed));
+
+    bool allMatch = true;
+    if (json) {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++)
+            printJson(results[i], i + 1 == results.size());
+        std::cout << "]\n";
+    } else {
+        std::cout << "pattern,accesses,scalar_ns,batch_ns,counters_match,"
+                  << "l1_hits,l1_misses,l2_hits,l2_misses,l1_conflict,l2_conflict,"
+                  << "memory_reads,prefetches,useful_prefetches,pollution\n";
+        for (const BenchResult &r : results)
+            printCsv(r);
+    }
+
+    for (const BenchResult &r : results)
+        allMatch = allMatch && r.countersMatch;
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+// Concurrent allocator benchmark: runs the same per-thread workload on 1, 2,
+// 4, ... N threads, once with per-thread arenas and once with a single
+// global arena behind one lock, and prints one result row per run.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -o concurrent_bench bench/concurrent_bench.cpp src/arena.cpp
+//       src/memory.cpp src/allocator.cpp src/address_index.cpp src/buddy.cpp
+//       src/tlsf.cpp src/slab.cpp src/block_table.cpp -pthread
+//
+// Usage:
+//   concurrent_bench [--threads 8] [--ops 200000] [--live 1000]
+//                    [--heap 16777216] [--remote 0.1] [--large 8192]
+//                    [--strategy tlsf] [--seed 42] [--format csv|json]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/arena.h"
+
+struct BenchConfig {
+    int maxThreads;
+    int ops;                    // per thread
+    int liveSet;                // per thread
+    MemSize heapPerThread;
+    double remote;              // share of blocks freed by another thread
+    MemSize largeThreshold;
+    AllocatorType strategy;
+    unsigned long long seed;
+    bool json;
+};
+
+struct BenchResult {
+    std::string mode;
+    int threads;
+    long long ops;
+    double seconds;
+    double opsPerSec;
+    double speedup;
+    ArenaStats stats;
+};
+
+// Blocks handed from one thread to the next, to be freed there
+struct alignas(64) Mailbox {
+    std::mutex lock;
+    std::vector<ArenaBlock> blocks;
+};
+
+// 95% small requests, 5% above the large threshold
+static int nextSize(std::mt19937_64 &rng) {
+    if (std::uniform_int_distribution<int>(0, 99)(rng) < 95)
+        return std::uniform_int_distribution<int>(16, 512)(rng);
+    return std::uniform_int_distribution<int>(8 * 1024, 32 * 1024)(rng);
+}
+
+static void worker(const BenchConfig &config, ConcurrentHeap &heap, int id, int threads,
+                   std::vector<Mailbox> &mailboxes, std::atomic<bool> &go,
+                   std::atomic<int> &finished) {
+    std::mt19937_64 rng(config.seed + id);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<ArenaBlock> live, outbox, inbox;
+    live.reserve(config.liveSet);
+    Mailbox &next = mailboxes[(id + 1) % threads];
+    Mailbox &own = mailboxes[id];
+
+    while (!go.load(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    for (int i = 0; i < config.ops; i++) {
+        // Every 64 ops, free what the previous thread passed on
+        if (i % 64 == 0) {
+            {
+                std::lock_guard<std::mutex> guard(own.lock);
+                inbox.swap(own.blocks);
+            }
+            for (const ArenaBlock &b : inbox)
+                heap.release(id, b);
+            inbox.clear();
+        }
+
+        if ((int)live.size() >= config.liveSet || (i % 2 == 1 && !live.empty())) {
+            size_t victim = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+            heap.release(id, live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        ArenaBlock b = heap.allocate(id, nextSize(rng));
+        if (b.id == -1)
+            continue;
+        if (unit(rng) >= config.remote) {
+            live.push_back(b);
+            continue;
+        }
+
+        outbox.push_back(b);
+        if (outbox.size() == 32) {
+            std::lock_guard<std::mutex> guard(next.lock);
+            next.blocks.insert(next.blocks.end(), outbox.begin(), outbox.end());
+            outbox.clear();
+        }
+    }
+
+    for (const ArenaBlock &b : live)
+        heap.release(id, b);
+    for (const ArenaBlock &b : outbox)
+        heap.release(id, b);
+
+    // Once every thread has stopped passing blocks on, free what is left
+    finished.fetch_add(1, std::memory_order_acq_rel);
+    while (finished.load(std::memory_order_acquire) < threads)
+        std::this_thread::yield();
+
+    for (const ArenaBlock &b : own.blocks)
+        heap.release(id, b);
+    own.blocks.clear();
+}
+
+static BenchResult runOne(const BenchConfig &config, int threads, bool arenas) {
+    typedef std::chrono::steady_clock Clock;
+
+    MemSize heapSize = config.heapPerThread * threads;
+    ConcurrentHeap heap(heapSize, arenas ? threads : 0,
+                        config.strategy, config.largeThreshold);
+    std::vector<Mailbox> mailboxes(threads);
+    std::atomic<bool> go(false);
+    std::atomic<int> finished(0);
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back(worker, std::cref(config), std::ref(heap), t, threads,
+                          std::ref(mailboxes), std::ref(go), std::ref(finished));
+
+    Clock::time_point begin = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread &t : pool)
+        t.join();
+    Clock::time_point end = Clock::now();
+
+    // Frees queued for arenas whose owner stopped allocating
+    heap.flushRemote();
+
+    BenchResult result;
+    result.mode = arenas ? "arenas" : "global_lock";
+    result.threads = threads;
+    result.ops = (long long)config.ops * threads;
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+    result.opsPerSec = result.seconds > 0 ? result.ops / result.seconds : 0.0;
+    result.speedup = 1.0;
+    result.stats = heap.getStats();
+    return result;
+}
+
+static void printCsvHeader() {
+    std::cout << "mode,threads,ops,seconds,ops_per_sec,speedup,"
+              << "allocations,frees,remote_frees,fallbacks,failures\n";
+}
+
+static void printCsv(const BenchResult &r) {
+    std::cout << r.mode << "," << r.threads << "," << r.ops << "," << r.seconds << ","
+              << (long long)r.opsPerSec << "," << r.speedup << ","
+              << r.stats.allocations << "," << r.stats.frees << ","
+              << r.stats.remoteFrees << "," << r.stats.fallbacks << ","
+              << r.stats.failures << "\n";
+}
+
+static void printJson(const BenchResult &r, bool last) {
+    std::cout << "  {\"mode\": \"" << r.mode << "\""
+              << ", \"threads\": " << r.threads
+              << ", \"ops\": " << r.ops
+              << ", \"seconds\": " << r.seconds
+              << ", \"ops_per_sec\": " << (long long)r.opsPerSec
+              << ", \"speedup\": " << r.speedup
+              << ", \"allocations\": " << r.stats.allocations
+              << ", \"frees\": " << r.stats.frees
+              << ", \"remote_frees\": " << r.stats.remoteFrees
+              << ", \"fallbacks\": " << r.stats.fallbacks
+              << ", \"failures\": " << r.stats.failures
+              << "}" << (last ? "\n" : ",\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+    config.maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    config.ops = 200000;
+    config.liveSet = 1000;
+    config.heapPerThread = 16 * 1024 * 1024;
+    config.remote = 0.1;
+    config.largeThreshold = 8192;
+    config.strategy = TLSF;
+    config.seed = 42;
+    config.json = false;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+
+        if (arg == "--threads")
+            config.maxThreads = std::stoi(value);
+        else if (arg == "--ops")
+            config.ops = std::stoi(value);
+        else if (arg == "--live")
+            config.liveSet = std::stoi(value);
+        else if (arg == "--heap")
+            config.heapPerThread = std::stoll(value);
+        else if (arg == "--remote")
+            config.remote = std::stod(value);
+        else if (arg == "--large")
+            config.largeThreshold = std::stoll(value);
+        else if (arg == "--strategy") {
+            if (!parseAllocatorType(value, config.strategy)) {
+                std::cerr << "Unknown strategy " << value << "\n";
+                return 1;
+            }
+        } else if (arg == "--seed")
+            config.seed = std::stoull(value);
+        else if (arg == "--format")
+            config.json = value == "json";
+        else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    // Powers of two, always finishing on the requested thread count
+    std::vector<int> counts;
+    for (int threads = 1; threads < config.maxThreads; threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(std::max(1, config.maxThreads));
+
+    std::vector<BenchResult> results;
+    bool leaked = false;
+    for (bool arenas : {true, false}) {
+        double base = 0.0;
+        for (int threads : counts) {
+            BenchResult r = runOne(config, threads, arenas);
+            if (threads == 1)
+                base = r.opsPerSec;
+            r.speedup = base > 0 ? r.opsPerSec / base : 0.0;
+            if (r.stats.allocations != r.stats.frees) {
+                std::cerr << r.mode << " with " << threads << " threads leaked "
+                          << r.stats.allocations - r.stats.frees << " blocks\n";
+                leaked = true;
+            }
+            results.push_back(r);
+        }
+    }
+
+    if (config.json) {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++)
+            printJson(results[i], i + 1 == results.size());
+        std::cout << "]\n";
+    } else {
+        printCsvHeader();
+        for (const BenchResult &r : results)
+            printCsv(r);
+    }
+    return leaked ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+// Container benchmark: runs std::pmr::vector and std::pmr::unordered_map
+// workloads on a backed heap through AllocatorResource, once per strategy,
+// plus the default new/delete resource as a baseline. The containers touch
+// the bytes each strategy placed, so the timings include the cache effects
+// of its layout and not just the bookkeeping.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -o pmr_bench bench/pmr_bench.cpp src/pmr_resource.cpp
+//       src/memory.cpp src/allocator.cpp src/address_index.cpp src/buddy.cpp
+//       src/tlsf.cpp src/slab.cpp src/block_table.cpp
+//
+// Usage:
+//   pmr_bench [--live 1000] [--ops 200000] [--heap 256M] [--seed 42]
+//             [--format csv|json]
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/memory.h"
+#include "../include/allocator.h"
+#include "../include/pmr_resource.h"
+
+enum Workload {
+    VECTORS,        // grow, scan and reset many small vectors
+    HASH_MAP        // insert, find and erase in one large map
+};
+
+struct BenchConfig {
+    int live;
+    int ops;
+    MemSize heapSize;
+    unsigned long long seed;
+    bool json;
+};
+
+struct BenchResult {
+    std::string workload;
+    std::string strategy;
+    int ops;                    // completed before the heap ran out
+    double nsPerOp;
+    long long checksum;         // same for every strategy that completes
+    ResourceStats resource;
+};
+
+static const char *workloadName(Workload w) {
+    return w == VECTORS ? "vector" : "unordered_map";
+}
+
+// Each op appends a few values to a random vector and sums another one;
+// one op in 16 drops a vector's storage so blocks keep being recycled
+static int runVectors(const BenchConfig &config, std::pmr::memory_resource *resource,
+                      long long &checksum) {
+    typedef std::pmr::vector<int64_t> Vector;
+
+    std::mt19937_64 rng(config.seed);
+    std::uniform_int_distribution<int> pick(0, config.live - 1);
+    std::uniform_int_distribution<int> grow(1, 32);
+
+    std::pmr::vector<Vector> vectors(resource);
+    vectors.reserve(config.live);
+    for (int i = 0; i < config.live; i++)
+        vectors.emplace_back();
+
+    int done = 0;
+    try {
+        for (; done < config.ops; done++) {
+            Vector &v = vectors[pick(rng)];
+            if (rng() % 16 == 0) {
+                Vector(v.get_allocator()).swap(v);
+                continue;
+            }
+
+            int n = grow(rng);
+            for (int k = 0; k < n; k++)
+                v.push_back((int64_t)done + k);
+
+            for (int64_t x : vectors[pick(rng)])
+                checksum += x;
+        }
+    } catch (const std::bad_alloc &) {
+    }
+    return done;
+}
+
+// Keeps about `live` * 16 keys: each op inserts one random key, erases
+// another and looks up two more
+static int runHashMap(const BenchConfig &config, std::pmr::memory_resource *resource,
+                      long long &checksum) {
+    typedef std::pmr::unordered_map<int64_t, int64_t> Map;
+
+    std::mt19937_64 rng(config.seed);
+    std::uniform_int_distribution<int64_t> key(0, (int64_t)config.live * 32 - 1);
+
+    Map map(resource);
+    int done = 0;
+    try {
+        for (; done < config.ops; done++) {
+            map[key(rng)] = done;
+            map.erase(key(rng));
+
+            for (int k = 0; k < 2; k++) {
+                Map::const_iterator it = map.find(key(rng));
+                if (it != map.end())
+                    checksum += it->second;
+            }
+        }
+    } catch (const std::bad_alloc &) {
+    }
+    return done;
+}
+
+static int runWorkload(Workload w, const BenchConfig &config,
+                       std::pmr::memory_resource *resource, long long &checksum) {
+    if (w == VECTORS)
+        return runVectors(config, resource, checksum);
+    return runHashMap(config, resource, checksum);
+}
+
+static BenchResult runOne(const BenchConfig &config, Workload w, bool baseline,
+                          AllocatorType strategy) {
+    typedef std::chrono::steady_clock Clock;
+
+    BenchResult result;
+    result.workload = workloadName(w);
+    result.strategy = baseline ? "new_delete" : allocatorTypeName(strategy);
+    result.checksum = 0;
+    result.resource = ResourceStats();
+
+    Memory mem;
+    Allocator alloc;
+    if (!baseline && !mem.init(config.heapSize, true)) {
+        std::cerr << "Could not map " << config.heapSize << " bytes\n";
+        result.ops = 0;
+        result.nsPerOp = 0.0;
+        return result;
+    }
+    alloc.setAllocator(strategy);
+    AllocatorResource resource(mem, alloc);
+
+    Clock::time_point begin = Clock::now();
+    if (baseline)
+        result.ops = runWorkload(w, config, std::pmr::new_delete_resource(), result.checksum);
+    else
+        result.ops = runWorkload(w, config, &resource, result.checksum);
+    Clock::time_point end = Clock::now();
+
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    result.nsPerOp = result.ops > 0 ? (double)ns / result.ops : 0.0;
+    if (!baseline)
+        result.resource = resource.getStats();
+    return result;
+}
+
+static void printCsvHeader() {
+    std::cout << "workload,strategy,ops,ns_per_op,checksum,allocations,failures,"
+              << "frees,peak_bytes\n";
+}
+
+static void printCsv(const BenchResult &r) {
+    std::cout << r.workload << "," << r.strategy << "," << r.ops << ","
+              << r.nsPerOp << "," << r.checksum << ","
+              << r.resource.allocations << "," << r.resource.failures << ","
+              << r.resource.frees << "," << r.resource.peakBytes << "\n";
+}
+
+static void printJson(const BenchResult &r, bool last) {
+    std::cout << "  {\"workload\": \"" << r.workload << "\""
+              << ", \"strategy\": \"" << r.strategy << "\""
+              << ", \"ops\": " << r.ops
+              << ", \"ns_per_op\": " << r.nsPerOp
+              << ", \"checksum\": " << r.checksum
+              << ", \"allocations\": " << r.resource.allocations
+              << ", \"failures\": " << r.resource.failures
+              << ", \"frees\": " << r.resource.frees
+              << ", \"peak_bytes\": " << r.resource.peakBytes
+              << "}" << (last ? "\n" : ",\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+    config.live = 1000;
+    config.ops = 200000;
+    config.heapSize = 256 * 1024 * 1024;
+    config.seed = 42;
+    config.json = false;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+
+        if (arg == "--live")
+            config.live = std::stoi(value);
+        else if (arg == "--ops")
+            config.ops = std::stoi(value);
+        else if (arg == "--heap") {
+            if (!parseMemSize(value, config.heapSize)) {
+                std::cerr << "Invalid heap size " << value << "\n";
+                return 1;
+            }
+        } else if (arg == "--seed")
+            config.seed = std::stoull(value);
+        else if (arg == "--format")
+            config.json = value == "json";
+        else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (config.live <= 0) {
+        std::cerr << "--live must be positive\n";
+        return 1;
+    }
+
+    const Workload workloads[] = {VECTORS, HASH_MAP};
+    const AllocatorType strategies[] = {FIRST_FIT, BEST_FIT, WORST_FIT, BUDDY, TLSF};
+
+    std::vector<BenchResult> results;
+    for (Workload w : workloads) {
+        results.push_back(runOne(config, w, true, FIRST_FIT));
+        for (AllocatorType strategy : strategies)
+            results.push_back(runOne(config, w, false, strategy));
+    }
+
+    if (config.json) {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++)
+            printJson(results[i], i + 1 == results.size());
+        std::cout << "]\n";
+    } else {
+        printCsvHeader();
+        for (const BenchResult &r : results)
+            printCsv(r);
+    }
+    return 0;
+}
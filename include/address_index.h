@@ -0,0 +1,43 @@
+#ifndef ADDRESS_INDEX_H
+#define ADDRESS_INDEX_H
+
+#include <vector>
+#include "block.h"
+
+// Address-ordered treap over the free blocks of a Memory.
+// Every node also stores the largest free size in its subtree, so the
+// lowest-address hole that fits a request is found in O(log n).
+class AddressIndex {
+private:
+    struct Node {
+        MemAddr start;
+        MemSize size;
+        MemSize maxSize;    // largest size in this subtree
+        unsigned priority;
+        int left;
+        int right;
+        BlockRef block;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> freeSlots;
+    int root;
+    unsigned seed;
+
+    unsigned nextPriority();
+    void pull(int n);
+    void split(int n, MemAddr start, int &l, int &r);
+    int merge(int l, int r);
+
+public:
+    AddressIndex();
+
+    void clear();
+    void insert(MemAddr start, MemSize size, BlockRef block);
+    void erase(MemAddr start);
+    bool findFirstFit(MemSize size, BlockRef &out, int &visited) const;
+    bool find(MemAddr start, BlockRef &out) const;
+    bool empty() const;
+};
+
+#endif
@@ -1,32 +1,137 @@
 #ifndef ALLOCATOR_H
 #define ALLOCATOR_H
 
+#include <string>
+
 #include "memory.h"
+#include "slab.h"
 
 enum AllocatorType {
     FIRST_FIT,
     BEST_FIT,
-    WORST_FIT
+    WORST_FIT,
+    BUDDY,
+    TLSF
+};
+
+// Maps the CLI names (first_fit, best_fit, ...) to a strategy
+bool parseAllocatorType(const std::string &name, AllocatorType &out);
+const char *allocatorTypeName(AllocatorType type);
+
+enum AllocFailure {
+    ALLOC_OK,
+    ALLOC_NO_MEMORY,            // no free block fits
+    ALLOC_INVALID_SIZE,         // size was zero or negative
+    ALLOC_BUDDY_NEEDS_EMPTY,    // buddy can only take over an empty memory
+    ALLOC_BUDDY_OWNS_MEMORY     // list strategies wait until buddy blocks are freed
+};
+
+// Outcome of one malloc, filled in without any printing
+struct AllocResult {
+    int id;                     // -1 on failure
+    MemAddr address;
+    MemSize blockSize;          // bytes reserved (rounded up for buddy and slabs)
+    AllocatorType strategy;
+    bool slab;                  // served by the slab layer
+    AllocFailure failure;
+    int scanned;                // blocks or index nodes looked at
+    MemSize compacted;          // bytes moved by compaction to make room
+    void *pointer;              // real bytes of the block on a backed heap, else nullptr
+};
+
+struct FreeResult {
+    int id;
+    bool ok;                    // false if the id was not allocated
+};
+
+// Totals over every compaction an Allocator ran
+struct CompactionStats {
+    long long runs;
+    long long automatic;        // run for a failed malloc, which then succeeded
+    long long blocksMoved;
+    long long bytesMoved;
+    long long nanoseconds;
+};
+
+// Receives allocator events. The allocator is silent without one.
+class AllocatorListener {
+public:
+    virtual ~AllocatorListener() {}
+    virtual void onAllocate(const AllocResult &result) = 0;
+    virtual void onFree(const FreeResult &result) = 0;
+};
+
+// Prints the simulator's usual messages to std::cout
+class ConsoleListener : public AllocatorListener {
+public:
+    void onAllocate(const AllocResult &result) override;
+    void onFree(const FreeResult &result) override;
 };
 
 class Allocator {
 private:
     int nextId;
     AllocatorType currentType;
+    AllocatorListener *listener;
+
+    // Optional slab front-end for small requests
+    bool slabEnabled;
+    SlabCache slabs;
+    const Memory *slabMemory;   // memory the slabs were carved from
+    int slabGeneration;
+    int nextInternalId;         // slab and page-frame blocks use ids below -1
+
+    // Compaction when a malloc fails although enough memory is free
+    bool autoCompact;
+    CompactionStats compaction;
+
+    AllocResult makeResult(AllocatorType strategy);
+    AllocResult mallocStrategy(Memory &mem, MemSize size);
+    AllocResult place(Memory &mem, BlockRef hole, MemSize size, AllocResult result);
+    bool findHole(Memory &mem, MemSize size, BlockRef &out);
+    bool reserveBlock(Memory &mem, MemSize size, int id, BlockRef &out);
+    void syncSlabs(Memory &mem);
+    AllocResult mallocSlab(Memory &mem, MemSize size);
+    bool freeSlab(Memory &mem, int id);
 
 public:
     Allocator();
 
     void setAllocator(AllocatorType type);
+    AllocatorType getAllocator() const;
+    void setSlab(bool enabled);
+    void setAutoCompact(bool enabled);
+    bool getAutoCompact() const;
+    void setListener(AllocatorListener *l);
+    AllocatorListener *getListener() const;
 
-    int mallocMemory(Memory &mem, int size);
-
-    // existing
-    int mallocFirstFit(Memory &mem, int size);
-    int mallocBestFit(Memory &mem, int size);
-    int mallocWorstFit(Memory &mem, int size);
+    AllocResult allocate(Memory &mem, MemSize size);
+    FreeResult release(Memory &mem, int id);
 
+    // Convenience wrappers, return the block id or -1
+    int mallocMemory(Memory &mem, MemSize size);
     void freeBlock(Memory &mem, int id);
+
+    // Blocks the simulator keeps for itself, such as page frames. They are
+    // placed with the current strategy but get internal ids below -1, so
+    // user ids are not used up and release() and the listener never see
+    // them. unreserve() only takes ids that reserve() returned.
+    AllocResult reserve(Memory &mem, MemSize size);
+    bool unreserve(Memory &mem, int id);
+
+    AllocResult mallocFirstFit(Memory &mem, MemSize size);
+    AllocResult mallocBestFit(Memory &mem, MemSize size);
+    AllocResult mallocWorstFit(Memory &mem, MemSize size);
+    AllocResult mallocBuddy(Memory &mem, MemSize size);
+    AllocResult mallocTlsf(Memory &mem, MemSize size);
+
+    // Runs Memory::compact, timing it and moving slabs along with their
+    // blocks. need <= 0 packs the whole heap.
+    bool compact(Memory &mem, MemSize need, CompactionResult &out);
+    const CompactionStats &getCompactionStats() const;
+
+    void printSlabStats(Memory &mem);
+    void printCompactionStats() const;
 };
 
 #endif
@@ -0,0 +1,94 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "allocator.h"
+#include "memory.h"
+
+// A block handed out by ConcurrentHeap: the arena it came from and that
+// arena's own block id, so no id counter is shared between threads
+struct ArenaBlock {
+    int arena;
+    int id;                     // -1 on failure
+    MemAddr address;            // in the whole heap
+};
+
+struct ArenaStats {
+    long long allocations;
+    long long frees;
+    long long remoteFrees;      // frees queued by other threads
+    long long fallbacks;        // requests served by the global arena
+    long long failures;
+};
+
+// Multi-producer, single-consumer list of freed block ids. Other threads
+// push with a CAS loop; the owner takes the whole list with one exchange,
+// so there is no ABA problem.
+class RemoteFreeQueue {
+private:
+    struct Node {
+        int id;
+        Node *next;
+    };
+
+    std::atomic<Node *> head;
+
+public:
+    RemoteFreeQueue();
+    ~RemoteFreeQueue();
+
+    void push(int id);
+    bool empty() const;
+    // Appends every pending id to `out` and empties the queue
+    void drain(std::vector<int> &out);
+};
+
+// Memory split into per-thread arenas plus a global arena for large
+// requests and for arenas that run out. Each arena is a Memory with its
+// own Allocator and lock. Thread t's home arena is t % (arena count), so
+// the home lock is uncontended while there are no more threads than
+// arenas, and threads beyond that share a home arena and its lock. A
+// thread frees blocks of other arenas by queueing them for their owner.
+// With no per-thread arenas everything goes through the global arena's
+// single lock, for comparison.
+class ConcurrentHeap {
+private:
+    struct alignas(64) Arena {
+        Memory mem;
+        Allocator alloc;
+        std::mutex lock;
+        RemoteFreeQueue remote;
+        MemAddr base;           // offset of this arena in the heap
+        ArenaStats stats;
+    };
+
+    std::vector<std::unique_ptr<Arena>> arenas;   // the global arena is last
+    MemSize largeThreshold;
+
+    Arena &global() { return *arenas.back(); }
+    int globalIndex() const { return arenas.size() - 1; }
+    bool tryAllocate(int index, MemSize size, ArenaBlock &out);
+    void drainRemote(Arena &arena);
+
+public:
+    // `threads` per-thread arenas (0 for a single global arena) sharing
+    // `totalSize` bytes; requests of `largeThreshold` bytes or more skip
+    // the per-thread arenas
+    ConcurrentHeap(MemSize totalSize, int threads, AllocatorType strategy, MemSize largeThreshold);
+
+    ArenaBlock allocate(int thread, MemSize size);
+    void release(int thread, const ArenaBlock &block);
+
+    int arenaCount() const;
+    // Runs the frees still queued for every arena, for when their owners
+    // have stopped allocating; call while no thread is using the heap
+    void flushRemote();
+    // Totals over all arenas; call while no thread is using the heap
+    ArenaStats getStats() const;
+};
+
+#endif
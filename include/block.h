@@ -0,0 +1,23 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <cstdint>
+
+// Simulated addresses and byte counts. 64-bit so heaps past 2 GB work and
+// start + size cannot overflow; signed so a negative request stays negative
+// and Allocator::allocate can reject it instead of seeing a huge size.
+typedef int64_t MemAddr;
+typedef int64_t MemSize;
+
+struct Block {
+    MemAddr start;      // starting address
+    MemSize size;       // size of block
+    bool free;          // free or allocated
+    int id;             // block id (-1 if free, below -1 for internal slab blocks)
+    MemSize requested;  // bytes asked for by malloc (0 if free)
+};
+
+// Handle to a block inside Memory's block table (a slot index)
+typedef int BlockRef;
+
+#endif
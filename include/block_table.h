@@ -0,0 +1,65 @@
+#ifndef BLOCK_TABLE_H
+#define BLOCK_TABLE_H
+
+#include <vector>
+#include "block.h"
+
+// Contiguous block storage for Memory.
+// Block fields live in parallel arrays indexed by slot, and address order is
+// kept with prev/next slot indices instead of list nodes. Erased slots go on a
+// freelist and are reused, so the arrays only grow to the peak block count.
+class BlockTable {
+private:
+    enum SlotState : unsigned char {
+        SLOT_USED,
+        SLOT_FREE,
+        SLOT_EMPTY      // not holding a block
+    };
+
+    std::vector<MemAddr> starts;
+    std::vector<MemSize> sizes;
+    std::vector<int> ids;
+    std::vector<MemSize> requesteds;
+    std::vector<unsigned char> states;
+    std::vector<int> prevs;
+    std::vector<int> nexts;
+    std::vector<int> emptySlots;
+    int head;
+    int tail;
+    int count;
+
+    int newSlot(const Block &b);
+
+public:
+    static constexpr int NONE = -1;
+
+    BlockTable();
+
+    void clear();
+    int insertBefore(int slot, const Block &b);    // NONE appends
+    void erase(int slot);
+
+    int first() const { return head; }
+    int last() const { return tail; }
+    int next(int slot) const { return nexts[slot]; }
+    int prev(int slot) const { return prevs[slot]; }
+    int size() const { return count; }
+    int capacity() const { return (int)states.size(); }
+
+    // Field access by slot
+    bool isLive(int slot) const { return states[slot] != SLOT_EMPTY; }
+    bool isFree(int slot) const { return states[slot] == SLOT_FREE; }
+    void setFree(int slot, bool free) { states[slot] = free ? SLOT_FREE : SLOT_USED; }
+    MemAddr &start(int slot) { return starts[slot]; }
+    MemSize &blockSize(int slot) { return sizes[slot]; }
+    int &id(int slot) { return ids[slot]; }
+    MemSize &requested(int slot) { return requesteds[slot]; }
+    MemAddr start(int slot) const { return starts[slot]; }
+    MemSize blockSize(int slot) const { return sizes[slot]; }
+    int id(int slot) const { return ids[slot]; }
+    MemSize requested(int slot) const { return requesteds[slot]; }
+
+    Block get(int slot) const;
+};
+
+#endif
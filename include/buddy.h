@@ -0,0 +1,42 @@
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "block.h"
+
+// Free-block bookkeeping for the buddy allocator.
+// One bitmap per order marks where free blocks of that order start, so a
+// block's buddy is checked with a single bit test. The bitmaps are sparse:
+// only 64-bit words with a bit set are stored, so a huge heap costs memory
+// per free block rather than per byte. Per-order stacks hand out a free
+// block without scanning the bitmap; entries whose bit has since been
+// cleared are stale and skipped.
+class BuddyIndex {
+private:
+    typedef std::unordered_map<MemAddr, unsigned long long> SparseBitmap;  // word -> bits
+
+    int maxOrder;
+    std::vector<SparseBitmap> bitmaps;                     // indexed by order
+    std::vector<std::vector<MemAddr>> freeStacks;          // indexed by order
+
+public:
+    static const int MIN_ORDER = 4;     // smallest buddy block is 16 bytes
+    static const int MAX_ORDER = 62;
+
+    BuddyIndex();
+
+    void reset(MemSize totalSize);
+    void clear();
+
+    void add(MemAddr start, int order);
+    bool remove(MemAddr start, int order);
+    bool pop(int order, MemAddr &start);
+
+    int getMaxOrder() const;
+
+    static int orderFor(MemSize size);
+};
+
+#endif
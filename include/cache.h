@@ -2,22 +2,205 @@
 #define CACHE_H
 
 #include <unordered_map>
-#include <queue>
+#include <unordered_set>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "block.h"
+#include "cache_policy.h"
+#include "prefetch.h"
+
+
+// Cache shape. lineSize == 0 is the original fully associative cache with
+// `ways` single-address entries; otherwise addresses map to lines of
+// lineSize bytes held in sets x ways slots (sets and lineSize powers of two).
+struct CacheGeometry {
+    int sets;
+    int ways;
+    int lineSize;
+};
+
+// Parses "<entries>" or "<sets>x<ways>x<line>"
+bool parseCacheGeometry(const std::string &spec, CacheGeometry &geometry);
+std::string describeCacheGeometry(const CacheGeometry &geometry);
+
+enum InclusionPolicy {
+    NON_INCLUSIVE,      // levels fill independently (default)
+    INCLUSIVE,          // L2 holds everything in L1; L2 evictions invalidate L1
+    EXCLUSIVE           // a line lives in one level; L2 holds L1's victims
+};
+
+// Arguments of "cache init <l1> <l2> [policy] [l2_policy] [modes...] [prefetcher]"
+struct CacheConfig {
+    CacheGeometry l1;
+    CacheGeometry l2;
+    CachePolicy l1Policy;
+    CachePolicy l2Policy;
+    bool policyGiven;
+    bool writeBack;         // false = write-through
+    bool writeAllocate;     // write misses bring the line in
+    InclusionPolicy inclusion;
+    PrefetchConfig prefetch;
+};
+
+bool parseCacheConfig(std::istream &args, CacheConfig &config, std::string &error);
+std::string describeCacheConfig(const CacheConfig &config);
+CacheConfig defaultCacheConfig(int l1Size, int l2Size);
+
+struct MissCounts {
+    long long compulsory;   // first reference to the line
+    long long capacity;     // a fully associative LRU cache of the same size misses too
+    long long conflict;     // only the set mapping made it miss
+};
+
+// Where a cache access was served from
+enum CacheLevelHit {
+    HIT_MEMORY = 0,
+    HIT_L1 = 1,
+    HIT_L2 = 2
+};
+
+struct CacheResult {
+    int value;
+    int level;          // CacheLevelHit
+};
+
+struct CacheStats {
+    long long l1Hits;
+    long long l1Misses;
+    long long l2Hits;
+    long long l2Misses;
+    long long memoryAccesses;
+    MissCounts l1Types;
+    MissCounts l2Types;
+    long long memoryReads;      // line (or entry) fetches from memory
+    long long memoryWrites;     // write-through stores and writebacks
+    long long bytesRead;
+    long long bytesWritten;
+    long long l1Writebacks;     // dirty L1 evictions
+    long long l2Writebacks;     // dirty L2 evictions
+    long long prefetchesIssued;     // lines fetched by the prefetcher
+    long long usefulPrefetches;     // prefetched lines later demanded
+    long long pollutionMisses;      // demand misses on lines a prefetch evicted
+};
+
+// What left a cache level: `count` words starting at address `first`.
+// `words` points into the level's scratch buffer and stays valid until the
+// level evicts again.
+struct CacheEviction {
+    MemAddr first;
+    int count;
+    int *words;
+    bool dirty;
+};
+
+// Main memory contents, one word per address, stored sparsely. Addresses
+// never written hold their own address (truncated to a word).
+class BackingMemory {
+private:
+    std::unordered_map<MemAddr, int> words;
+
+public:
+    int read(MemAddr addr) const;
+    void write(MemAddr addr, int value);
+};
+
+// Fully associative LRU cache of lines that sees the same accesses as a
+// set-associative level, used to split its misses into the three kinds.
+class MissClassifier {
+private:
+    int capacity;
+    LruPolicy lru;
+    std::vector<uint64_t> lines;
+    std::vector<int> emptySlots;
+    std::unordered_map<uint64_t, int> slotOf;
+
+public:
+    MissClassifier(int capacity);
+
+    // Records an access to `line`; on a miss of the real cache, bumps the
+    // matching counter
+    void access(uint64_t line, bool missed, MissCounts &counts);
+};
 
 
 class CacheLevel {
 private:
+    static constexpr MemAddr EMPTY_TAG = -1;
+
+    CacheGeometry geometry;
     int capacity;
-    std::unordered_map<int, int> data;
-    std::queue<int> fifo;
+    CachePolicy policyType;
+    std::vector<std::unique_ptr<ReplacementPolicy>> policies;    // one per set
+
+    // Fully associative mode: entries live in fixed slots and the map
+    // only resolves key -> slot
+    std::vector<MemAddr> keys;
+    std::vector<int> values;
+    std::vector<int> emptySlots;
+    std::unordered_map<MemAddr, int> slotOf;
+
+    std::vector<char> dirty;            // per slot
+    std::vector<int> evictedWords;      // scratch for CacheEviction
+
+    // Set-associative mode: set s owns tags[s * ways .. s * ways + ways)
+    // and the matching lineSize words of lineData per way
+    int lineShift;
+    int setShift;
+    std::vector<MemAddr> tags;
+    std::vector<int> lineData;
+    MissClassifier classifier;
+    MissCounts misses;
+
+    bool lineMode() const { return geometry.lineSize > 0; }
+    uint64_t lineOf(MemAddr key) const { return (uint64_t)key >> lineShift; }
+    int setOf(uint64_t line) const { return (int)(line & (geometry.sets - 1)); }
+    MemAddr tagOf(uint64_t line) const { return (MemAddr)(line >> setShift); }
+    int findWay(MemAddr key) const;
+    int findInSet(const MemAddr *setTags, MemAddr tag) const;
+    int findSlot(MemAddr key) const;
+    int allocateSlot(MemAddr key, CacheEviction *evicted);
+    void releaseSlot(int slot);
+    void touchSlot(int slot);
+    void saveEviction(int slot, CacheEviction *evicted);
+    int *slotWords(int slot);
+    const int *slotWords(int slot) const;
+    int wordIndex(MemAddr key) const { return lineMode() ? (int)(key & (geometry.lineSize - 1)) : 0; }
+    MemAddr firstAddress(MemAddr key) const { return lineMode() ? (MemAddr)(lineOf(key) << lineShift) : key; }
 
 public:
-    CacheLevel(int cap);
+    CacheLevel(int cap, CachePolicy policy = CACHE_FIFO);
+    CacheLevel(const CacheGeometry &geometry, CachePolicy policy = CACHE_FIFO);
+
+    bool contains(MemAddr key) const;
+    bool peek(MemAddr key, int &value) const;   // no replacement update
+    bool lookup(MemAddr key, int &value);       // single lookup, counts as a use
+    int get(MemAddr key);
+    void put(MemAddr key, int value, const CacheLevel *source = nullptr);
 
-    bool contains(int key);
-    int get(int key);
-    void put(int key, int value);
+    // Updates key if present. Returns false on a miss.
+    bool write(MemAddr key, int value, bool markDirty, bool touch = true);
+
+    // The calls below make room when the set is full and return true if
+    // they evicted something, described in *evicted.
+    // fill: brings key's entry (or line) in, taking data from `source`
+    // where it holds it and from `memory` otherwise
+    bool fill(MemAddr key, const CacheLevel *source, const BackingMemory *memory = nullptr,
+              CacheEviction *evicted = nullptr);
+    // insertLine: installs a whole line handed over by another level
+    bool insertLine(MemAddr key, const int *words, bool isDirty, CacheEviction *evicted);
+    // invalidate: drops key's entry, returning its contents in *removed
+    bool invalidate(MemAddr key, CacheEviction *removed);
+
+    void prefetch(MemAddr key) const;          // hint the host CPU to load key's set
+    int wordsPerLine() const { return lineMode() ? geometry.lineSize : 1; }
+    CachePolicy getPolicy() const;
+    bool isSetAssociative() const;
+    const MissCounts &getMissCounts() const;
     void display(const std::string& name) const;
 };
 
@@ -27,16 +210,55 @@ private:
     CacheLevel L1;
     CacheLevel L2;
 
-    int l1Hits;
-    int l1Misses;
-    int l2Hits;
-    int l2Misses;
-    int memoryAccesses;
+    long long l1Hits;
+    long long l1Misses;
+    long long l2Hits;
+    long long l2Misses;
+    long long memoryAccesses;
+    long long memoryReads;
+    long long memoryWrites;
+    long long bytesRead;
+    long long bytesWritten;
+    long long l1Writebacks;
+    long long l2Writebacks;
+    long long prefetchesIssued;
+    long long usefulPrefetches;
+    long long pollutionMisses;
+
+    BackingMemory memory;
+    bool writeBack;
+    bool writeAllocate;
+    InclusionPolicy inclusion;
+
+    // Prefetching in front of L2, tracked in L2 line numbers
+    PrefetchConfig prefetchConfig;
+    std::unique_ptr<Prefetcher> prefetcher;
+    std::vector<uint64_t> prefetchQueue;
+    std::unordered_set<uint64_t> prefetchedLines;   // in L2, not yet demanded
+    std::unordered_set<uint64_t> pollutedLines;     // evicted by a prefetch
+
+    int access(MemAddr key, int &level);
+    uint64_t l2LineOf(MemAddr key) const { return (uint64_t)key / L2.wordsPerLine(); }
+    void installLine(MemAddr key);
+    void runPrefetcher(MemAddr key, bool trigger);
+    void prefetchLine(uint64_t line);
+    void promote(MemAddr key);
+    void loadFromMemory(MemAddr key);
+    void bringIntoL1(MemAddr key);
+    void writeToMemory(const int *words, MemAddr first, int count);
+    void evictedFromL1(const CacheEviction &e);
+    void evictedFromL2(CacheEviction e);
 public:
-    TwoLevelCache(int l1Size, int l2Size);
+    TwoLevelCache(int l1Size, int l2Size,
+                  CachePolicy l1Policy = CACHE_FIFO, CachePolicy l2Policy = CACHE_FIFO);
+    TwoLevelCache(const CacheConfig &config);
 
-    int get(int key);
-    void put(int key, int value);
+    int get(MemAddr key);
+    // Same as calling get() on each address in order, counters included;
+    // works through the addresses in blocks, loading their sets up front
+    void getBatch(const MemAddr *addrs, size_t n, CacheResult *out);
+    void put(MemAddr key, int value);
+    CacheStats getStats() const;
     void display() const;
     void stats() const;
 };
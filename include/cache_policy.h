@@ -0,0 +1,168 @@
+#ifndef CACHE_POLICY_H
+#define CACHE_POLICY_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "block.h"
+
+enum CachePolicy {
+    CACHE_FIFO,
+    CACHE_LRU,
+    CACHE_LFU,
+    CACHE_CLOCK,
+    CACHE_ARC
+};
+
+bool parseCachePolicy(const std::string &name, CachePolicy &policy);
+const char *cachePolicyName(CachePolicy policy);
+
+// Decides which slot of a cache level to evict. A level owns `capacity`
+// slots numbered 0..capacity-1 and reports every change to its policy:
+// inserted() when a key is placed in a slot, touched() on every hit,
+// removed() when a key leaves its slot. victim() is only asked when every
+// slot is in use, right before the incoming key replaces the returned one.
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() {}
+
+    virtual void inserted(int slot, MemAddr key) = 0;
+    virtual void touched(int slot) = 0;
+    virtual void removed(int slot, MemAddr key) = 0;
+    virtual int victim(MemAddr incomingKey) = 0;
+
+    // Occupied slots in eviction order (next victim first), for display
+    virtual void order(std::vector<int> &slots) const = 0;
+};
+
+std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(CachePolicy policy, int capacity);
+
+// Doubly linked lists threaded through per-slot prev/next arrays, so a
+// slot can be moved between lists without allocating.
+struct SlotList {
+    int head;
+    int tail;
+    int size;
+
+    SlotList() : head(-1), tail(-1), size(0) {}
+};
+
+class SlotLinks {
+private:
+    std::vector<int> prevs;
+    std::vector<int> nexts;
+
+public:
+    SlotLinks(int capacity);
+
+    void pushBack(SlotList &list, int slot);
+    void unlink(SlotList &list, int slot);
+    int next(int slot) const { return nexts[slot]; }
+};
+
+class FifoPolicy : public ReplacementPolicy {
+private:
+    SlotLinks links;
+    SlotList queue;
+
+public:
+    FifoPolicy(int capacity);
+
+    void inserted(int slot, MemAddr key) override;
+    void touched(int slot) override;
+    void removed(int slot, MemAddr key) override;
+    int victim(MemAddr incomingKey) override;
+    void order(std::vector<int> &slots) const override;
+};
+
+class LruPolicy : public ReplacementPolicy {
+private:
+    SlotLinks links;
+    SlotList recency;           // head = least recently used
+
+public:
+    LruPolicy(int capacity);
+
+    void inserted(int slot, MemAddr key) override;
+    void touched(int slot) override;
+    void removed(int slot, MemAddr key) override;
+    int victim(MemAddr incomingKey) override;
+    void order(std::vector<int> &slots) const override;
+};
+
+// O(1) LFU: one recency list per use count, ties broken by LRU
+class LfuPolicy : public ReplacementPolicy {
+private:
+    SlotLinks links;
+    std::vector<int> counts;
+    std::unordered_map<int, SlotList> buckets;
+    int minCount;
+
+    void unlinkFromBucket(int slot);
+
+public:
+    LfuPolicy(int capacity);
+
+    void inserted(int slot, MemAddr key) override;
+    void touched(int slot) override;
+    void removed(int slot, MemAddr key) override;
+    int victim(MemAddr incomingKey) override;
+    void order(std::vector<int> &slots) const override;
+};
+
+class ClockPolicy : public ReplacementPolicy {
+private:
+    std::vector<char> referenced;
+    std::vector<char> used;
+    int hand;
+
+public:
+    ClockPolicy(int capacity);
+
+    void inserted(int slot, MemAddr key) override;
+    void touched(int slot) override;
+    void removed(int slot, MemAddr key) override;
+    int victim(MemAddr incomingKey) override;
+    void order(std::vector<int> &slots) const override;
+};
+
+// Adaptive Replacement Cache (Megiddo & Modha). T1/T2 hold resident slots
+// seen once / more than once; B1/B2 remember keys recently evicted from
+// each, and hits in them move the T1 target size `target`.
+class ArcPolicy : public ReplacementPolicy {
+private:
+    struct Ghost {
+        std::list<MemAddr>::iterator pos;
+        bool inB2;
+    };
+
+    int capacity;
+    int target;
+    SlotLinks links;
+    SlotList t1;
+    SlotList t2;
+    std::vector<char> inT2;
+    std::list<MemAddr> b1;          // front = least recent
+    std::list<MemAddr> b2;
+    std::unordered_map<MemAddr, Ghost> ghosts;
+    bool adapted;
+    MemAddr adaptedKey;
+
+    void adapt(MemAddr key);
+    void dropGhost(std::list<MemAddr> &list);
+    void remember(MemAddr key, bool toB2);
+
+public:
+    ArcPolicy(int capacity);
+
+    void inserted(int slot, MemAddr key) override;
+    void touched(int slot) override;
+    void removed(int slot, MemAddr key) override;
+    int victim(MemAddr incomingKey) override;
+    void order(std::vector<int> &slots) const override;
+};
+
+#endif
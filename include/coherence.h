@@ -0,0 +1,135 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.h"
+
+enum MesiState : char {
+    MESI_INVALID,
+    MESI_SHARED,
+    MESI_EXCLUSIVE,
+    MESI_MODIFIED
+};
+
+struct CoreAccess {
+    MemAddr addr;
+    bool write;
+};
+
+struct CoreStats {
+    long long reads;
+    long long writes;
+    long long hits;
+    long long misses;
+    long long coherenceMisses;      // misses on lines another core invalidated
+    long long falseSharing;         // ... where that core never wrote the word needed
+};
+
+struct CoherenceStats {
+    long long invalidations;        // remote copies dropped by writes
+    long long upgrades;             // S -> M bus upgrades
+    long long cacheToCache;         // misses served from another core's L1
+    long long writebacks;           // M lines evicted or flushed to L2
+    long long l2Hits;
+    long long l2Misses;
+    long long epochs;
+};
+
+// Reusable barrier: the last thread to arrive runs `complete` while the
+// others wait, then all continue (std::barrier is C++20)
+class EpochBarrier {
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int parties;
+    int waiting;
+    unsigned long long generation;
+
+public:
+    EpochBarrier(int parties);
+
+    template <typename F>
+    void wait(F &&complete) {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned long long gen = generation;
+        if (++waiting == parties) {
+            complete();
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return generation != gen; });
+    }
+};
+
+// N private set-associative L1s kept coherent with snooping MESI, in front
+// of one shared L2. Only line states are modelled, not data.
+class MultiCoreCache {
+private:
+    static const int WORD_SIZE = 4;
+
+    // Everything a worker thread touches for its core in the parallel
+    // phase, on its own cache lines
+    struct alignas(64) Core {
+        std::vector<uint64_t> lines;            // per slot
+        std::vector<char> states;               // MesiState per slot
+        std::vector<uint64_t> written;          // words written since the fill
+        std::vector<std::unique_ptr<ReplacementPolicy>> policies;  // per set
+        // Lines lost to remote writes -> words written remotely since
+        std::unordered_map<uint64_t, uint64_t> invalidated;
+        CoreStats stats;
+        size_t position;                        // next access in the stream
+        bool pending;                           // stopped at a bus transaction
+    };
+
+    CacheGeometry l1Geometry;
+    int lineShift;
+    int setShift;
+    int wordShift;
+    std::vector<Core> cores;
+    CacheLevel L2;
+    CoherenceStats bus;
+
+    uint64_t lineOf(MemAddr addr) const { return (uint64_t)addr >> lineShift; }
+    uint64_t wordBit(MemAddr addr) const;
+    int findSlot(const Core &core, uint64_t line) const;
+    int allocateSlot(Core &core, uint64_t line);
+    void invalidateSlot(Core &core, int slot);
+    bool tryLocal(Core &core, const CoreAccess &a);
+    void busTransaction(int id, const CoreAccess &a);
+    void writeBackLine(uint64_t line);
+
+public:
+    MultiCoreCache(int cores, const CacheGeometry &l1, const CacheGeometry &l2,
+                   CachePolicy policy = CACHE_LRU);
+
+    // Runs one access stream per core. Each epoch every core performs up to
+    // epochLength L1 hits on its worker thread, stopping early at the first
+    // access that needs the bus; the bus transactions then run serially in
+    // core order. Results do not depend on the thread count.
+    void run(const std::vector<std::vector<CoreAccess>> &streams, int threads, int epochLength);
+
+    int coreCount() const { return cores.size(); }
+    const CoreStats &getCoreStats(int core) const;
+    CoreStats getTotals() const;
+    const CoherenceStats &getCoherenceStats() const;
+    void stats() const;
+};
+
+// Reads "<core> <r|w> <address>" lines into one stream per core
+bool loadCoreTrace(const std::string &path, int cores,
+                   std::vector<std::vector<CoreAccess>> &streams, std::string &error);
+
+// memsim --multicore driver
+int runMultiCore(const std::string &path, int cores, const std::string &l1, const std::string &l2,
+                 const std::string &policy, int threads, int epochLength);
+
+#endif
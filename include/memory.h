@@ -1,29 +1,140 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
-#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <iostream>
 
-struct Block {
-    int start;      // starting address
-    int size;       // size of block
-    bool free;      // free or allocated
-    int id;         // block id (-1 if free)
+#include "block.h"
+#include "block_table.h"
+#include "address_index.h"
+#include "buddy.h"
+#include "tlsf.h"
+
+// Snapshot of the numbers printed by Memory::printStats
+struct MemoryStats {
+    MemSize totalMemory;
+    MemSize usedMemory;
+    MemSize freeMemory;
+    MemSize largestFree;
+    int blockCount;
+    int freeBlocks;
+    double utilization;             // percent of total memory in use
+    double externalFragmentation;   // percent of free memory outside the largest hole
+    double internalFragmentation;   // percent of used memory not requested
+};
+
+// Reads a byte count with an optional K, M, G or T suffix (powers of 1024)
+bool parseMemSize(const std::string &text, MemSize &out);
+
+// What one Memory::compact call moved
+struct CompactionResult {
+    int blocksMoved;
+    MemSize bytesMoved;
+    BlockRef hole;              // the merged free block, BlockTable::NONE if none
+    std::vector<std::pair<int, MemAddr>> moves; // (block id, new start)
 };
 
 class Memory {
 private:
-    int totalSize;
-    std::list<Block> blocks;   // linked list of blocks
+    // Free indexes are built the first time a strategy asks for one and
+    // kept in sync from then on, so each strategy only pays for its own.
+    enum FreeIndexKind {
+        ADDRESS_INDEX = 1,
+        SIZE_INDEX = 2,
+        TLSF_INDEX = 4
+    };
+
+    MemSize totalSize;
+    unsigned char *backing;    // mmap'd bytes behind the heap, nullptr if not backed
+    size_t backingLength;
+    int generation;            // bumped by init, lets callers drop stale state
+    int layoutVersion;         // bumped when compaction moves blocks
+    int lastScanned;           // blocks or index nodes the last search looked at
+    BlockTable blocks;         // blocks in address order
+    AddressIndex freeByAddress; // free blocks ordered by start address
+    std::map<std::pair<MemSize, MemAddr>, BlockRef> freeBySize; // (size, start) -> free block
+    TlsfIndex freeByClass;     // free blocks in segregated size classes
+    unsigned activeIndexes;    // FreeIndexKind bits
+    std::unordered_map<int, BlockRef> usedById; // block id -> allocated block
+    BuddyIndex buddyFree;      // per-order free bitmaps while buddy managed
+    bool buddyManaged;
+
+    // Running totals behind getStats, updated as blocks are indexed,
+    // allocated and released instead of being recounted per query
+    MemSize freeBytes;
+    int freeBlockCount;
+    MemSize wastedBytes;       // allocated but not requested
+    std::map<MemSize, int> freeSizeCounts; // free block size -> how many
+
+    void unmapBacking();
+    void clearLayout();
+    void resetLayout();
+    void addFreeBlock(MemAddr start, MemSize size);
+    void useIndex(FreeIndexKind kind);
+    void indexFree(BlockRef block);
+    void unindexFree(BlockRef block);
+    void buddyRelease(BlockRef block);
 
 public:
     Memory();
+    ~Memory();
+    Memory(const Memory &) = delete;
+    Memory &operator=(const Memory &) = delete;
 
-    void init(int size);
+    // With `backed` the heap also reserves `size` real bytes (an anonymous
+    // mmap, pages are only touched on use), so allocations can hand out
+    // pointers. Returns false and leaves the memory as it was if the
+    // region cannot be mapped.
+    bool init(MemSize size, bool backed = false);
+    bool isBacked() const;
+    // Real address of a heap address, nullptr if the heap is not backed
+    // or the address is outside it
+    void *pointerAt(MemAddr address) const;
     void dump();
-    int getTotalSize();
-    std::list<Block>& getBlocks();
+    MemSize getTotalSize();
+    int getGeneration() const;
+    int getLayoutVersion() const;
+    int getLastScanned() const;
+    const BlockTable& getBlocks() const;
+    Block getBlock(BlockRef block) const;
     void printStats();
+    // O(1): read from the running totals
+    MemoryStats getStats() const;
+    // Recomputes the same numbers by walking every block, for checking
+    MemoryStats scanStats() const;
+    // Free block size -> number of free blocks of that size
+    const std::map<MemSize, int> &getFreeSizeCounts() const;
+
+    // Block operations that keep the free indexes in sync.
+    // Allocators should split and merge blocks only through these.
+    bool findFirstFit(MemSize size, BlockRef &out);
+    bool findBestFit(MemSize size, BlockRef &out);
+    bool findWorstFit(MemSize size, BlockRef &out);
+    bool findTlsfFit(MemSize size, BlockRef &out);
+    bool findById(int id, BlockRef &out);
+    void adjustRequested(int id, MemSize delta);
+    BlockRef allocateFrom(BlockRef hole, MemSize size, int id);
+    void release(BlockRef block);
+
+    // Buddy layout: the heap is carved into aligned power-of-two blocks.
+    // Only possible while nothing is allocated.
+    bool enableBuddy();
+    bool disableBuddy();
+    bool isBuddyManaged() const;
+    bool buddyAllocate(MemSize size, int id, BlockRef &out);
+    bool hasAllocations() const;
+
+    // Slides allocated blocks together until one free block of `need`
+    // bytes exists, moving as few bytes as it can; need <= 0 packs the
+    // whole heap. Block ids and slots stay the same, only starts change.
+    // Fails on a buddy-managed heap or when there is not enough free memory.
+    // On a backed heap the bytes move with their blocks, so earlier
+    // pointers into moved blocks are stale.
+    bool compact(MemSize need, CompactionResult &out);
 };
 
 #endif
@@ -0,0 +1,123 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "allocator.h"
+#include "cache.h"
+#include "memory.h"
+
+// Log-linear latency histogram in the style of HdrHistogram: values below
+// 2^SUB_BITS get their own bucket, larger ones share 2^(SUB_BITS-1)
+// buckets per power of two, so any value is kept to within ~3%.
+// record() is O(1) and the memory use is fixed.
+class LatencyHistogram {
+private:
+    static const int SUB_BITS = 6;
+    static const int HALF = 1 << (SUB_BITS - 1);
+    static const int MAGNITUDES = 40;       // up to ~2^45 ns
+
+    std::vector<long long> counts;
+    long long total;
+    long long maxValue;
+    long double sum;
+
+    static int bucketOf(long long value);
+    static long long highestIn(int bucket);
+
+public:
+    LatencyHistogram();
+
+    void record(long long value, long long count = 1);
+    void add(const LatencyHistogram &other);
+    void reset();
+
+    long long count() const { return total; }
+    long long max() const { return maxValue; }
+    double mean() const;
+    // Smallest recorded bucket value with at least `percent` of the
+    // samples at or below it
+    long long percentile(double percent) const;
+};
+
+// Upper bounds of the free-block size classes sampled by MetricsRecorder;
+// the last class holds everything larger
+const int FREE_SIZE_CLASSES = 8;
+extern const int FREE_SIZE_BOUNDS[FREE_SIZE_CLASSES - 1];
+
+struct MetricsSample {
+    long long ops;                  // operations recorded so far
+    long long mallocs;
+    long long failedMallocs;
+    long long frees;
+    long long cacheAccesses;
+    double utilization;
+    double externalFragmentation;
+    int freeBlocks;
+    MemSize largestFree;
+    int freeSizes[FREE_SIZE_CLASSES];
+    double scannedPerMalloc;        // blocks or index nodes looked at
+    long long mallocP50;
+    long long mallocP99;
+    long long mallocMax;
+    long long freeP50;
+    long long freeP99;
+    long long cacheP50;
+    long long cacheP99;
+};
+
+// Times allocator and cache calls made through it, and every `interval`
+// operations records a sample of heap shape and latency since the last one.
+// Samples are kept in memory; once exportCsv() opens a file, every sample
+// so far is written and later ones are appended as they are taken.
+class MetricsRecorder {
+private:
+    bool enabled;
+    int interval;
+    long long ops;
+    long long mallocs;
+    long long failedMallocs;
+    long long frees;
+    long long cacheAccesses;
+    long long scanned;              // this interval
+    long long intervalMallocs;
+
+    LatencyHistogram mallocLatency; // this interval
+    LatencyHistogram freeLatency;
+    LatencyHistogram cacheLatency;
+    LatencyHistogram mallocTotal;   // whole run
+    LatencyHistogram freeTotal;
+    LatencyHistogram cacheTotal;
+
+    std::vector<MetricsSample> samples;
+    std::ofstream out;
+
+    void tick(const Memory &mem, long long count = 1);
+    void writeRow(const MetricsSample &s);
+
+public:
+    MetricsRecorder(int interval = 1000);
+
+    void setEnabled(bool on);
+    bool isEnabled() const;
+    void setInterval(int n);
+    int getInterval() const;
+
+    AllocResult allocate(Allocator &alloc, Memory &mem, MemSize size);
+    FreeResult release(Allocator &alloc, Memory &mem, int id);
+    int get(TwoLevelCache &cache, MemAddr address, const Memory &mem);
+    // A batch of cache accesses timed as a whole, e.g. from replay
+    void recordCacheBatch(long long ns, size_t n, const Memory &mem);
+
+    // Takes a sample now, even mid-interval
+    void sample(const Memory &mem);
+    bool exportCsv(const std::string &path, std::string &error);
+    void close();
+
+    const std::vector<MetricsSample> &getSamples() const;
+    void print() const;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef MRC_H
+#define MRC_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "block.h"
+
+struct MrcPoint {
+    long long capacity;     // entries (or lines) in a fully associative LRU cache
+    double hitRatio;
+};
+
+// One-pass LRU miss-ratio curve (Mattson stack distances). A Fenwick tree
+// over access times marks the latest access of every key, so the number of
+// distinct keys touched since a key's previous access is a range count.
+// With sampleRate < 1 only keys whose hash falls under the rate are
+// tracked and their distances scaled up (fixed-rate SHARDS).
+class MissRatioCurve {
+private:
+    std::vector<int> tree;                          // Fenwick, 1-based
+    std::unordered_map<uint64_t, long long> lastAccess;
+    std::vector<long long> histogram;               // hits by (scaled) stack distance
+    long long now;
+    long long references;
+    long long sampled;
+    double rate;
+    uint32_t threshold;
+    int lineShift;
+
+    void add(long long pos, int delta);
+    long long prefix(long long pos) const;
+    void compact();
+
+public:
+    MissRatioCurve(double sampleRate = 1.0, int lineSize = 1);
+
+    // counted = false updates recency without scoring the access (puts)
+    void access(MemAddr address, bool counted = true);
+
+    double hitRatio(long long capacity) const;
+    long long distinctKeys() const;
+    std::vector<MrcPoint> curve() const;    // power-of-two capacities
+    void print() const;
+};
+
+// Builds the curve from the cache records of a binary trace and prints it
+int analyzeMissRatio(const std::string &path, double sampleRate, int lineSize);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef PMR_RESOURCE_H
+#define PMR_RESOURCE_H
+
+#include <cstddef>
+#include <memory_resource>
+
+#include "allocator.h"
+#include "memory.h"
+
+struct ResourceStats {
+    long long allocations;
+    long long frees;
+    long long failures;         // requests that threw std::bad_alloc
+    long long bytesInUse;       // asked for by the container, without headers
+    long long peakBytes;
+};
+
+// std::pmr::memory_resource on top of a backed Memory, so a standard
+// container allocates through the simulator's strategies and works on the
+// real bytes they place. Each allocation asks the Allocator for a block
+// with room for the block id and the alignment, stores the id just below
+// the pointer it returns, and deallocation frees that id again.
+//
+// Not thread-safe, and blocks must stay where they were placed: leave
+// auto-compaction off and do not compact while a container holds memory.
+class AllocatorResource : public std::pmr::memory_resource {
+private:
+    Memory &mem;
+    Allocator &alloc;
+    ResourceStats stats;
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+public:
+    // `memory` must have been initialized with backed = true
+    AllocatorResource(Memory &memory, Allocator &allocator);
+
+    const ResourceStats &getStats() const;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum PrefetchKind {
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE,     // fetch the next `degree` lines after a miss
+    PREFETCH_STRIDE,        // detect a constant stride per address region
+    PREFETCH_STREAM         // sequential stream buffers beside L2
+};
+
+struct PrefetchConfig {
+    PrefetchKind kind;
+    int degree;             // lines fetched ahead (next-line, stride)
+    int buffers;            // stream buffers
+    int depth;              // lines per stream buffer
+};
+
+PrefetchConfig defaultPrefetchConfig();
+
+// Parses "next-line[:degree]", "stride[:degree]" or "stream[:<buffers>x<depth>]".
+// Returns false if `word` is not a prefetcher.
+bool parsePrefetchConfig(const std::string &word, PrefetchConfig &config);
+std::string describePrefetchConfig(const PrefetchConfig &config);
+
+// Watches the L2 demand stream, in L2 line numbers, and decides what to
+// fetch ahead of it.
+class Prefetcher {
+public:
+    virtual ~Prefetcher() {}
+
+    // Called on every L2 demand access. `trigger` is set on a miss and on
+    // the first use of a prefetched line. Appends lines to fetch to `out`.
+    virtual void access(uint64_t line, bool trigger, std::vector<uint64_t> &out) = 0;
+
+    // Prefetchers that keep fetched lines outside the cache return true
+    // here; the lines they report are then held by the prefetcher and
+    // handed over through claim()
+    virtual bool buffered() const { return false; }
+    // On an L2 miss: removes `line` from the prefetcher's buffers if held
+    virtual bool claim(uint64_t line) { (void)line; return false; }
+};
+
+std::unique_ptr<Prefetcher> makePrefetcher(const PrefetchConfig &config);
+
+class NextLinePrefetcher : public Prefetcher {
+private:
+    int degree;
+
+public:
+    NextLinePrefetcher(int degree);
+
+    void access(uint64_t line, bool trigger, std::vector<uint64_t> &out) override;
+};
+
+// Reference prediction table indexed by address region instead of by
+// instruction (the simulator has no PCs). An entry that sees the same
+// nonzero stride twice in a row starts prefetching along it.
+class StridePrefetcher : public Prefetcher {
+private:
+    static const int TABLE_SIZE = 64;
+    static const int REGION_SHIFT = 6;      // 64 lines per region
+
+    struct Entry {
+        uint64_t region;
+        uint64_t lastLine;
+        long long stride;
+        int confidence;
+        bool valid;
+    };
+
+    int degree;
+    std::vector<Entry> table;
+
+public:
+    StridePrefetcher(int degree);
+
+    void access(uint64_t line, bool trigger, std::vector<uint64_t> &out) override;
+};
+
+// Jouppi stream buffers: a miss that no buffer holds restarts the least
+// recently used buffer at the following lines; a miss found in a buffer
+// takes the line from it and tops the buffer up.
+class StreamBuffers : public Prefetcher {
+private:
+    struct Buffer {
+        std::vector<uint64_t> lines;    // next line to hand over first
+        uint64_t nextLine;              // next line to fetch into the buffer
+        long long lastUse;
+    };
+
+    int depth;
+    std::vector<Buffer> buffers;
+    long long clock;
+    int claimed;                        // buffer hit by the last claim, or -1
+
+    void topUp(Buffer &buffer, std::vector<uint64_t> &out);
+
+public:
+    StreamBuffers(int buffers, int depth);
+
+    void access(uint64_t line, bool trigger, std::vector<uint64_t> &out) override;
+    bool buffered() const override { return true; }
+    bool claim(uint64_t line) override;
+};
+
+#endif
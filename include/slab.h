@@ -0,0 +1,62 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <vector>
+#include <unordered_map>
+
+#include "block.h"
+
+// Size-class slabs for small allocations.
+// Each slab is one block carved out of Memory and split into
+// OBJECTS_PER_SLAB equal objects tracked by a bitmap. Slabs with a free
+// object sit on a per-class partial list, so allocation and free are O(1).
+class SlabCache {
+private:
+    struct Slab {
+        int blockId;        // backing block in Memory
+        MemAddr start;
+        int sizeClass;
+        unsigned used;      // bit i set when object i is live
+        int prevPartial;    // links in the class's partial list, -1 at the ends
+        int nextPartial;
+    };
+
+    struct ObjectRef {
+        int slab;
+        int slot;
+        int requested;
+    };
+
+    std::vector<Slab> slabs;
+    std::vector<int> freeSlabSlots;
+    std::vector<int> partialHead;
+    std::vector<int> slabCount;
+    std::vector<int> liveCount;
+    std::unordered_map<int, ObjectRef> objects;    // object id -> location
+
+    void linkPartial(int s);
+    void unlinkPartial(int s);
+
+public:
+    static const int CLASS_COUNT = 5;       // 16, 32, 64, 128, 256 bytes
+    static const int OBJECTS_PER_SLAB = 32;
+
+    SlabCache();
+
+    static int classFor(MemSize size);
+    static int classSize(int sizeClass);
+
+    void reset();
+    bool empty() const;
+    bool owns(int objectId) const;
+
+    void addSlab(int sizeClass, int blockId, MemAddr start);
+    // The slab's backing block was moved by compaction
+    void moveSlab(int blockId, MemAddr start);
+    bool allocate(int sizeClass, int objectId, int requested, MemAddr &address, int &blockId);
+    bool release(int objectId, int &requested, int &blockId, bool &slabEmpty);
+
+    void printStats() const;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TLSF_H
+#define TLSF_H
+
+#include <vector>
+#include "block.h"
+
+// Two-level segregated fit index over the free blocks of a Memory.
+// The first level splits sizes by power of two, the second level splits
+// each power-of-two range into SL_COUNT equal classes. A bitmap per level
+// records which classes have free blocks, so finding a fitting class is two
+// find-first-set operations regardless of how many blocks exist.
+class TlsfIndex {
+private:
+    static const int SL_BITS = 4;
+    static const int SL_COUNT = 1 << SL_BITS;
+    static const int FL_COUNT = 64 - SL_BITS;
+
+    unsigned long long flBitmap;
+    unsigned slBitmap[FL_COUNT];
+    int heads[FL_COUNT][SL_COUNT];     // first block of each class, -1 if empty
+
+    // Intrusive class lists, indexed by block slot
+    std::vector<int> nextInClass;
+    std::vector<int> prevInClass;
+    std::vector<MemSize> linkedSize;   // size the block was filed under, -1 if unlinked
+
+    static int lastSet(unsigned long long value);
+    static int firstSet(unsigned long long value);
+    static void mapping(long long size, int &fl, int &sl);
+
+public:
+    TlsfIndex();
+
+    void clear();
+    void insert(BlockRef block, MemSize size);
+    void erase(BlockRef block);
+    bool findFit(MemSize size, BlockRef &out, int &visited) const;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "block.h"
+
+// Binary trace format: a TraceHeader followed by fixed-width TraceRecords.
+// Records mirror the text commands that change simulator state; commands
+// that only print (dump, stats, cache display, ...) are dropped.
+enum TraceOp : uint32_t {
+    TRACE_INIT = 1,         // arg = memory size, arg2 = 1 for a backed heap
+    TRACE_MALLOC,           // arg = size
+    TRACE_FREE,             // arg = block id
+    TRACE_SET_ALLOCATOR,    // arg = AllocatorType
+    TRACE_SET_SLAB,         // arg = 1 on, 0 off
+    TRACE_CACHE_INIT,       // arg = L1 size | L1 policy << 32 | L2 policy << 40
+                            //       | modes << 48, arg2 = L2 size
+    TRACE_CACHE_ACCESS,     // arg = address
+    TRACE_CACHE_PUT,        // arg = address, arg2 = value
+    TRACE_CACHE_INIT_LINES, // arg = L1 geometry | L2 geometry << 32 (packed),
+                            // arg2 = L1 policy | L2 policy << 8 | modes << 16
+    TRACE_CACHE_PREFETCH,   // arg = packed prefetcher, right after a cache init
+    TRACE_SET_COMPACT,      // arg = 1 on, 0 off
+    TRACE_COMPACT           // arg = bytes needed, 0 for the whole heap
+};
+
+struct TraceHeader {
+    char magic[4];          // "MSTR"
+    uint32_t version;
+    uint64_t count;         // number of records
+};
+
+struct TraceRecord {
+    uint32_t op;
+    int32_t arg2;
+    int64_t arg;
+};
+
+static_assert(sizeof(TraceHeader) == 16, "trace header must stay 16 bytes");
+static_assert(sizeof(TraceRecord) == 16, "trace records must stay 16 bytes");
+
+// Read-only view of a trace file, memory-mapped where the platform allows
+class TraceFile {
+private:
+    const unsigned char *data;
+    size_t length;
+    bool mapped;
+    std::vector<unsigned char> buffer;     // fallback when mmap is unavailable
+
+public:
+    TraceFile();
+    ~TraceFile();
+    TraceFile(const TraceFile &) = delete;
+    TraceFile &operator=(const TraceFile &) = delete;
+
+    bool open(const std::string &path, std::string &error);
+    void close();
+
+    const TraceRecord *records() const;
+    size_t size() const;
+};
+
+// Parses one text command and appends its records (usually one). Returns
+// false for commands that are not part of the trace (output-only or unknown).
+bool parseTraceCommand(const std::string &line, std::vector<TraceRecord> &records);
+
+// Converts a text command script into a binary trace
+bool convertTrace(const std::string &textPath, const std::string &binaryPath,
+                  size_t &written, std::string &error);
+
+// Replays a binary trace silently and prints a throughput summary; with a
+// metrics path, also samples fragmentation and latency every `interval` ops
+// into that CSV file
+int replayTrace(const std::string &path, const std::string &metricsPath = "",
+                int interval = 1000);
+
+// Reads a binary trace, or parses a text command script, into records
+bool loadTraceRecords(const std::string &path, std::vector<TraceRecord> &records,
+                      std::string &error);
+
+// memsim --compare driver: replays the allocator records of a trace once per
+// (strategy, heap size) on a pool of threads and prints a table of results.
+// A heap size of 0 keeps the trace's own init sizes.
+int compareStrategies(const std::string &path, const std::vector<std::string> &strategies,
+                      const std::vector<MemSize> &heapSizes, int threads);
+
+#endif
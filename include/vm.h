@@ -0,0 +1,154 @@
+#ifndef VM_H
+#define VM_H
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "allocator.h"
+#include "cache_policy.h"
+#include "memory.h"
+
+enum PageReplacement {
+    PAGE_FIFO,
+    PAGE_LRU,
+    PAGE_CLOCK,
+    PAGE_OPT            // Belady: evict the page used furthest in the future
+};
+
+// Arguments of "vm init <frames> <page_size> [levels] [tlb] [policy] [huge]"
+struct VmConfig {
+    int frames;                 // resident page limit
+    int pageSize;               // bytes, power of two
+    std::vector<int> levelBits; // index bits per page table level, root first
+    int tlbSets;
+    int tlbWays;
+    PageReplacement policy;
+    bool hugePages;             // map with last-level-sized pages instead
+};
+
+bool parseVmConfig(std::istream &args, VmConfig &config, std::string &error);
+std::string describeVmConfig(const VmConfig &config);
+const char *pageReplacementName(PageReplacement policy);
+
+struct VmStats {
+    long long accesses;
+    long long tlbHits;
+    long long tlbMisses;
+    long long walkSteps;        // page table entries read by walks
+    long long pageFaults;
+    long long evictions;
+    long long dirtyEvictions;   // evicted pages that had been written
+    long long tableNodes;       // page table nodes allocated
+    int residentPages;
+};
+
+// How one access was translated
+struct Translation {
+    MemAddr physical;           // -1 if the access could not be mapped
+    bool outOfRange;            // beyond the page tables' address bits
+    bool tlbHit;
+    bool pageFault;
+    bool evicted;               // the fault replaced another page
+    int victimPid;
+    uint64_t victimPage;
+};
+
+// Per-process virtual address spaces over frames taken from Memory through
+// the Allocator. Each frame is one allocated block of the (huge) page size.
+class VirtualMemory {
+private:
+    struct TableNode {
+        std::vector<std::unique_ptr<TableNode>> children;  // interior levels
+        std::vector<int> frames;                            // leaf: frame or -1
+    };
+
+    struct Process {
+        TableNode root;
+        int pages;
+        int nodes;
+    };
+
+    struct Frame {
+        int blockId;            // -1 while the slot has no block
+        MemAddr base;           // physical address
+        int pid;
+        uint64_t page;
+        bool dirty;
+        bool used;
+    };
+
+    struct TlbEntry {
+        int pid;
+        uint64_t page;
+        int frame;
+        bool valid;
+    };
+
+    VmConfig config;
+    int offsetBits;             // bits below the page number
+    int addressBits;            // virtual address width
+    int levels;                 // page table levels actually walked
+    int pageBytes;              // bytes per mapped page (huge or not)
+    Memory &mem;
+    Allocator &alloc;
+    int memoryGeneration;
+    int memoryLayout;           // Memory layout version the frame bases match
+
+    std::map<int, Process> processes;
+    std::vector<Frame> frames;
+    std::vector<int> freeFrames;
+    std::unique_ptr<ReplacementPolicy> policy;
+    std::vector<TlbEntry> tlb;
+    std::vector<std::unique_ptr<ReplacementPolicy>> tlbPolicies;   // per set
+    VmStats stats;
+
+    // Optimal replacement: next use of each resident frame's page
+    bool optimal;
+    long long nextUse;
+    std::vector<long long> frameNextUse;
+    std::set<std::pair<long long, int>> byNextUse;
+
+    int tlbSetOf(uint64_t page) const { return (int)(page & (config.tlbSets - 1)); }
+    int tlbLookup(int pid, uint64_t page);
+    void tlbInsert(int pid, uint64_t page, int frame);
+    void tlbInvalidate(int pid, uint64_t page);
+
+    int *walk(Process &process, uint64_t page, bool create);
+    int indexAt(uint64_t page, int level) const;
+    int takeFrame(Translation &t);
+    void evict(int frame);
+    void touchFrame(int frame, bool inserted);
+    void dropFrame(int frame);
+    void reset();
+    void checkGeneration();
+
+public:
+    VirtualMemory(const VmConfig &config, Memory &mem, Allocator &alloc);
+    ~VirtualMemory();
+
+    // Translates one access; page faults map a frame, evicting if needed
+    Translation access(int pid, uint64_t vaddr, bool write);
+    // Optimal replacement only: position of the next access to the same
+    // page, set before each access (-1 = never used again)
+    void setNextUse(long long when);
+
+    bool freeProcess(int pid);
+    const VmConfig &getConfig() const;
+    int getPageBytes() const;
+    VmStats getStats() const;
+    void display(int pid);
+    void printStats() const;
+};
+
+// memsim --vm driver: replays "<pid> <r|w> <vaddr>" lines, optionally
+// through a two-level cache
+int runVmTrace(const std::string &path, const VmConfig &config, MemSize memorySize,
+               const std::string &cacheSpec);
+
+#endif
@@ -0,0 +1,137 @@
+#include "../include/address_index.h"
+
+AddressIndex::AddressIndex() {
+    root = -1;
+    seed = 2463534242u;
+}
+
+unsigned AddressIndex::nextPriority() {
+    // xorshift32, only needs to be "random enough" to keep the treap balanced
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+void AddressIndex::pull(int n) {
+    Node &node = nodes[n];
+    node.maxSize = node.size;
+    if (node.left != -1 && nodes[node.left].maxSize > node.maxSize)
+        node.maxSize = nodes[node.left].maxSize;
+    if (node.right != -1 && nodes[node.right].maxSize > node.maxSize)
+        node.maxSize = nodes[node.right].maxSize;
+}
+
+// Splits subtree n into keys < start (l) and keys >= start (r)
+void AddressIndex::split(int n, MemAddr start, int &l, int &r) {
+    if (n == -1) {
+        l = r = -1;
+        return;
+    }
+
+    if (nodes[n].start < start) {
+        split(nodes[n].right, start, nodes[n].right, r);
+        l = n;
+    } else {
+        split(nodes[n].left, start, l, nodes[n].left);
+        r = n;
+    }
+    pull(n);
+}
+
+// Merges two subtrees where every key in l is smaller than every key in r
+int AddressIndex::merge(int l, int r) {
+    if (l == -1) return r;
+    if (r == -1) return l;
+
+    if (nodes[l].priority > nodes[r].priority) {
+        nodes[l].right = merge(nodes[l].right, r);
+        pull(l);
+        return l;
+    }
+
+    nodes[r].left = merge(l, nodes[r].left);
+    pull(r);
+    return r;
+}
+
+void AddressIndex::clear() {
+    nodes.clear();
+    freeSlots.clear();
+    root = -1;
+}
+
+void AddressIndex::insert(MemAddr start, MemSize size, BlockRef block) {
+    Node node;
+    node.start = start;
+    node.size = size;
+    node.maxSize = size;
+    node.priority = nextPriority();
+    node.left = -1;
+    node.right = -1;
+    node.block = block;
+
+    int n;
+    if (!freeSlots.empty()) {
+        n = freeSlots.back();
+        freeSlots.pop_back();
+        nodes[n] = node;
+    } else {
+        n = (int)nodes.size();
+        nodes.push_back(node);
+    }
+
+    int l, r;
+    split(root, start, l, r);
+    root = merge(merge(l, n), r);
+}
+
+void AddressIndex::erase(MemAddr start) {
+    int l, mid, r;
+    split(root, start, l, r);
+    split(r, start + 1, mid, r);
+
+    if (mid != -1)
+        freeSlots.push_back(mid);
+
+    root = merge(l, r);
+}
+
+bool AddressIndex::findFirstFit(MemSize size, BlockRef &out, int &visited) const {
+    int n = root;
+    visited = 0;
+    if (n == -1 || nodes[n].maxSize < size)
+        return false;
+
+    while (n != -1) {
+        const Node &node = nodes[n];
+        visited++;
+
+        // Anything at a lower address that fits wins
+        if (node.left != -1 && nodes[node.left].maxSize >= size) {
+            n = node.left;
+        } else if (node.size >= size) {
+            out = node.block;
+            return true;
+        } else {
+            n = node.right;
+        }
+    }
+    return false;
+}
+
+bool AddressIndex::find(MemAddr start, BlockRef &out) const {
+    int n = root;
+    while (n != -1) {
+        if (nodes[n].start == start) {
+            out = nodes[n].block;
+            return true;
+        }
+        n = start < nodes[n].start ? nodes[n].left : nodes[n].right;
+    }
+    return false;
+}
+
+bool AddressIndex::empty() const {
+    return root == -1;
+}
@@ -1,9 +1,101 @@
 #include "../include/allocator.h"
+#include <chrono>
 #include <iostream>
 
+bool parseAllocatorType(const std::string &name, AllocatorType &out) {
+    if (name == "first_fit")
+        out = FIRST_FIT;
+    else if (name == "best_fit")
+        out = BEST_FIT;
+    else if (name == "worst_fit")
+        out = WORST_FIT;
+    else if (name == "buddy")
+        out = BUDDY;
+    else if (name == "tlsf")
+        out = TLSF;
+    else
+        return false;
+    return true;
+}
+
+const char *allocatorTypeName(AllocatorType type) {
+    switch (type) {
+    case BEST_FIT:
+        return "best_fit";
+    case WORST_FIT:
+        return "worst_fit";
+    case BUDDY:
+        return "buddy";
+    case TLSF:
+        return "tlsf";
+    default:
+        return "first_fit";
+    }
+}
+
+void ConsoleListener::onAllocate(const AllocResult &result) {
+    if (result.failure == ALLOC_INVALID_SIZE) {
+        std::cout << "Allocation failed: size must be positive\n";
+        return;
+    }
+    if (result.failure == ALLOC_BUDDY_NEEDS_EMPTY) {
+        std::cout << "Allocation failed: buddy allocator needs an empty memory\n";
+        return;
+    }
+    if (result.failure == ALLOC_BUDDY_OWNS_MEMORY) {
+        std::cout << "Allocation failed: memory is managed by the buddy allocator\n";
+        return;
+    }
+    if (result.failure == ALLOC_NO_MEMORY) {
+        if (result.strategy == FIRST_FIT)
+            std::cout << "Allocation failed: Not enough memory\n";
+        else
+            std::cout << "Allocation failed\n";
+        return;
+    }
+
+    if (result.compacted > 0)
+        std::cout << "Compacted memory, moved " << result.compacted << " bytes\n";
+
+    if (result.slab)
+        std::cout << "Allocated (Slab " << result.blockSize << "B) id=";
+    else if (result.strategy == FIRST_FIT)
+        std::cout << "Allocated block id=";
+    else if (result.strategy == BEST_FIT)
+        std::cout << "Allocated (Best Fit) id=";
+    else if (result.strategy == WORST_FIT)
+        std::cout << "Allocated (Worst Fit) id=";
+    else if (result.strategy == TLSF)
+        std::cout << "Allocated (TLSF) id=";
+    else
+        std::cout << "Allocated (Buddy) id=";
+
+    std::cout << result.id
+              << " at address=0x"
+              << std::hex << result.address << std::dec;
+
+    if (result.strategy == BUDDY && !result.slab)
+        std::cout << " (block size=" << result.blockSize << ")";
+    std::cout << "\n";
+}
+
+void ConsoleListener::onFree(const FreeResult &result) {
+    if (result.ok)
+        std::cout << "Block " << result.id << " freed\n";
+    else
+        std::cout << "Invalid free request: block id not found\n";
+}
+
 Allocator::Allocator() {
     nextId = 1;
     currentType = FIRST_FIT;
+    listener = nullptr;
+    slabEnabled = false;
+    slabMemory = nullptr;
+    slabGeneration = 0;
+    nextInternalId = -2;
+    autoCompact = false;
+    compaction = CompactionStats{0, 0, 0, 0, 0};
 }
 
 void Allocator::setAllocator(AllocatorType type) {
@@ -11,159 +103,395 @@ void Allocator::setAllocator(AllocatorType type) {
     //std::cout << "Allocator switched\n";
 }
 
-int Allocator::mallocMemory(Memory &mem, int size) {
+AllocatorType Allocator::getAllocator() const {
+    return currentType;
+}
+
+void Allocator::setSlab(bool enabled) {
+    slabEnabled = enabled;
+}
+
+void Allocator::setAutoCompact(bool enabled) {
+    autoCompact = enabled;
+}
+
+bool Allocator::getAutoCompact() const {
+    return autoCompact;
+}
+
+void Allocator::setListener(AllocatorListener *l) {
+    listener = l;
+}
+
+AllocatorListener *Allocator::getListener() const {
+    return listener;
+}
+
+AllocResult Allocator::allocate(Memory &mem, MemSize size) {
+    AllocResult result;
+    bool served = false;
+
+    if (size <= 0) {
+        result = makeResult(currentType);
+        result.failure = ALLOC_INVALID_SIZE;
+        if (listener)
+            listener->onAllocate(result);
+        return result;
+    }
+
+    if (slabEnabled && SlabCache::classFor(size) != -1) {
+        result = mallocSlab(mem, size);
+        served = result.failure == ALLOC_OK;
+        // No room for a new slab, fall back to a normal block
+    }
+
+    if (!served)
+        result = mallocStrategy(mem, size);
+
+    // Enough memory is free but split up: slide blocks together and use
+    // the hole that makes, which is the only one big enough
+    if (result.failure == ALLOC_NO_MEMORY && autoCompact && currentType != BUDDY) {
+        CompactionResult moved;
+        int scanned = result.scanned;
+        if (compact(mem, size, moved)) {
+            result = place(mem, moved.hole, size, makeResult(currentType));
+            result.scanned = scanned;
+            result.compacted = moved.bytesMoved;
+            compaction.automatic++;
+        }
+    }
+
+    if (result.failure == ALLOC_OK)
+        result.pointer = mem.pointerAt(result.address);
+
+    if (listener)
+        listener->onAllocate(result);
+    return result;
+}
+
+AllocResult Allocator::mallocStrategy(Memory &mem, MemSize size) {
+    if (currentType == BUDDY)
+        return mallocBuddy(mem, size);
+
+    if (mem.isBuddyManaged() && !mem.disableBuddy()) {
+        // A buddy-managed heap goes back to a single free block once it is empty
+        AllocResult result = makeResult(currentType);
+        result.failure = ALLOC_BUDDY_OWNS_MEMORY;
+        return result;
+    }
+
     if (currentType == FIRST_FIT)
         return mallocFirstFit(mem, size);
     else if (currentType == BEST_FIT)
         return mallocBestFit(mem, size);
+    else if (currentType == TLSF)
+        return mallocTlsf(mem, size);
     else
         return mallocWorstFit(mem, size);
 }
 
-int Allocator::mallocFirstFit(Memory &mem, int size) {
-    auto &blocks = mem.getBlocks();
+FreeResult Allocator::release(Memory &mem, int id) {
+    FreeResult result;
+    result.id = id;
+    result.ok = true;
+
+    if (!freeSlab(mem, id)) {
+        BlockRef block;
+
+        // Straight to the block through the id table, no list walk.
+        // Slab blocks (ids below -1) are only released by the slab layer.
+        if (id < 0 || !mem.findById(id, block)) {
+            result.ok = false;
+        } else {
+            // Mark free and coalesce with neighbours
+            mem.release(block);
+        }
+    }
 
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (it->free && it->size >= size) {
+    if (listener)
+        listener->onFree(result);
+    return result;
+}
 
-            // Create allocated block
-            Block allocated;
-            allocated.start = it->start;
-            allocated.size = size;
-            allocated.free = false;
-            allocated.id = nextId++;
+int Allocator::mallocMemory(Memory &mem, MemSize size) {
+    return allocate(mem, size).id;
+}
 
-            // Modify current free block
-            it->start += size;
-            it->size -= size;
+void Allocator::freeBlock(Memory &mem, int id) {
+    release(mem, id);
+}
 
-            // Insert allocated block before free block
-            blocks.insert(it, allocated);
+AllocResult Allocator::reserve(Memory &mem, MemSize size) {
+    AllocResult result = makeResult(currentType);
+    if (size <= 0) {
+        result.failure = ALLOC_INVALID_SIZE;
+        return result;
+    }
 
-            // If free block becomes size 0, remove it
-            if (it->size == 0) {
-                blocks.erase(it);
-            }
+    BlockRef block;
+    bool found = reserveBlock(mem, size, nextInternalId, block);
+    if (!found && autoCompact && currentType != BUDDY) {
+        CompactionResult moved;
+        if (compact(mem, size, moved)) {
+            block = mem.allocateFrom(moved.hole, size, nextInternalId);
+            result.compacted = moved.bytesMoved;
+            compaction.automatic++;
+            found = true;
+        }
+    }
+    if (!found)
+        return result;
+
+    Block reserved = mem.getBlock(block);
+    result.id = nextInternalId--;
+    result.address = reserved.start;
+    result.blockSize = reserved.size;
+    result.failure = ALLOC_OK;
+    result.pointer = mem.pointerAt(reserved.start);
+    return result;
+}
 
-            std::cout << "Allocated block id=" << allocated.id
-                      << " at address=0x"
-                      << std::hex << allocated.start << std::dec << "\n";
+bool Allocator::unreserve(Memory &mem, int id) {
+    BlockRef block;
+    if (id >= -1 || !mem.findById(id, block))
+        return false;
+    mem.release(block);
+    return true;
+}
 
-            return allocated.id;
-        }
+AllocResult Allocator::makeResult(AllocatorType strategy) {
+    AllocResult result;
+    result.id = -1;
+    result.address = 0;
+    result.blockSize = 0;
+    result.strategy = strategy;
+    result.slab = false;
+    result.failure = ALLOC_NO_MEMORY;
+    result.scanned = 0;
+    result.compacted = 0;
+    result.pointer = nullptr;
+    return result;
+}
+
+// Carves the request out of the hole a strategy picked
+AllocResult Allocator::place(Memory &mem, BlockRef hole, MemSize size, AllocResult result) {
+    Block allocated = mem.getBlock(mem.allocateFrom(hole, size, nextId++));
+
+    result.id = allocated.id;
+    result.address = allocated.start;
+    result.blockSize = allocated.size;
+    result.failure = ALLOC_OK;
+    return result;
+}
+
+AllocResult Allocator::mallocFirstFit(Memory &mem, MemSize size) {
+    AllocResult result = makeResult(FIRST_FIT);
+    BlockRef hole;
+
+    // Lowest-address free block that fits, same as a front-to-back scan
+    bool found = mem.findFirstFit(size, hole);
+    result.scanned = mem.getLastScanned();
+
+    if (found)
+        return place(mem, hole, size, result);
+    return result;
+}
+
+AllocResult Allocator::mallocBestFit(Memory &mem, MemSize size) {
+    AllocResult result = makeResult(BEST_FIT);
+    BlockRef best;
+
+    bool found = mem.findBestFit(size, best);
+    result.scanned = mem.getLastScanned();
+
+    if (found)
+        return place(mem, best, size, result);
+    return result;
+}
+
+AllocResult Allocator::mallocWorstFit(Memory &mem, MemSize size) {
+    AllocResult result = makeResult(WORST_FIT);
+    BlockRef worst;
+
+    bool found = mem.findWorstFit(size, worst);
+    result.scanned = mem.getLastScanned();
+
+    if (found)
+        return place(mem, worst, size, result);
+    return result;
+}
+
+AllocResult Allocator::mallocTlsf(Memory &mem, MemSize size) {
+    AllocResult result = makeResult(TLSF);
+    BlockRef hole;
+
+    // Good fit from the segregated lists, split like the other strategies
+    bool found = mem.findTlsfFit(size, hole);
+    result.scanned = mem.getLastScanned();
+
+    if (found)
+        return place(mem, hole, size, result);
+    return result;
+}
+
+AllocResult Allocator::mallocBuddy(Memory &mem, MemSize size) {
+    AllocResult result = makeResult(BUDDY);
+
+    if (!mem.isBuddyManaged() && !mem.enableBuddy()) {
+        result.failure = ALLOC_BUDDY_NEEDS_EMPTY;
+        return result;
     }
 
-    std::cout << "Allocation failed: Not enough memory\n";
-    return -1;
+    BlockRef block;
+    bool found = mem.buddyAllocate(size, nextId, block);
+    result.scanned = mem.getLastScanned();
+    if (!found)
+        return result;
+    nextId++;
+
+    Block allocated = mem.getBlock(block);
+    result.id = allocated.id;
+    result.address = allocated.start;
+    result.blockSize = allocated.size;
+    result.failure = ALLOC_OK;
+    return result;
 }
 
-int Allocator::mallocBestFit(Memory &mem, int size) {
-    auto &blocks = mem.getBlocks();
-    auto best = blocks.end();
+// Finds a hole with the current list strategy
+bool Allocator::findHole(Memory &mem, MemSize size, BlockRef &out) {
+    if (currentType == FIRST_FIT)
+        return mem.findFirstFit(size, out);
+    else if (currentType == BEST_FIT)
+        return mem.findBestFit(size, out);
+    else if (currentType == TLSF)
+        return mem.findTlsfFit(size, out);
+    else
+        return mem.findWorstFit(size, out);
+}
 
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (it->free && it->size >= size) {
-            if (best == blocks.end() || it->size < best->size) {
-                best = it;
-            }
-        }
+// Allocates a block with the current strategy, outside the id sequence
+bool Allocator::reserveBlock(Memory &mem, MemSize size, int id, BlockRef &out) {
+    if (currentType == BUDDY) {
+        if (!mem.isBuddyManaged() && !mem.enableBuddy())
+            return false;
+        return mem.buddyAllocate(size, id, out);
     }
 
-    if (best == blocks.end()) {
-        std::cout << "Allocation failed\n";
-        return -1;
+    if (mem.isBuddyManaged() && !mem.disableBuddy())
+        return false;
+
+    BlockRef hole;
+    if (!findHole(mem, size, hole))
+        return false;
+
+    out = mem.allocateFrom(hole, size, id);
+    return true;
+}
+
+// Slabs belong to one memory; re-initializing it drops them
+void Allocator::syncSlabs(Memory &mem) {
+    if (slabMemory != &mem || slabGeneration != mem.getGeneration()) {
+        slabs.reset();
+        slabMemory = &mem;
+        slabGeneration = mem.getGeneration();
     }
+}
 
-    Block allocated;
-    allocated.start = best->start;
-    allocated.size = size;
-    allocated.free = false;
-    allocated.id = nextId++;
+AllocResult Allocator::mallocSlab(Memory &mem, MemSize size) {
+    syncSlabs(mem);
 
-    best->start += size;
-    best->size -= size;
+    AllocResult result = makeResult(currentType);
+    result.slab = true;
 
-    blocks.insert(best, allocated);
-    if (best->size == 0)
-        blocks.erase(best);
+    int sizeClass = SlabCache::classFor(size);
+    MemAddr address;
+    int blockId;
 
-    std::cout << "Allocated (Best Fit) id=" << allocated.id
-              << " at address=0x"
-              << std::hex << allocated.start << std::dec << "\n";
+    if (!slabs.allocate(sizeClass, nextId, (int)size, address, blockId)) {
+        // Carve a new slab for this class
+        MemSize slabBytes = SlabCache::classSize(sizeClass) * SlabCache::OBJECTS_PER_SLAB;
+        BlockRef block;
+        if (!reserveBlock(mem, slabBytes, nextInternalId, block))
+            return result;
+
+        mem.adjustRequested(nextInternalId, -slabBytes);   // nothing requested yet
+        slabs.addSlab(sizeClass, nextInternalId, mem.getBlock(block).start);
+        nextInternalId--;
+
+        slabs.allocate(sizeClass, nextId, (int)size, address, blockId);
+    }
 
-    return allocated.id;
+    mem.adjustRequested(blockId, size);
+
+    result.id = nextId++;
+    result.address = address;
+    result.blockSize = SlabCache::classSize(sizeClass);
+    result.failure = ALLOC_OK;
+    result.scanned = 1;
+    return result;
 }
 
-int Allocator::mallocWorstFit(Memory &mem, int size) {
-    auto &blocks = mem.getBlocks();
-    auto worst = blocks.end();
+bool Allocator::freeSlab(Memory &mem, int id) {
+    syncSlabs(mem);
 
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (it->free && it->size >= size) {
-            if (worst == blocks.end() || it->size > worst->size) {
-                worst = it;
-            }
-        }
-    }
+    int requested, blockId;
+    bool slabEmpty;
+    if (!slabs.release(id, requested, blockId, slabEmpty))
+        return false;
+
+    mem.adjustRequested(blockId, -requested);
 
-    if (worst == blocks.end()) {
-        std::cout << "Allocation failed\n";
-        return -1;
+    // Empty slabs go straight back to the general allocator
+    if (slabEmpty) {
+        BlockRef block;
+        if (mem.findById(blockId, block))
+            mem.release(block);
     }
+    return true;
+}
 
-    Block allocated;
-    allocated.start = worst->start;
-    allocated.size = size;
-    allocated.free = false;
-    allocated.id = nextId++;
+void Allocator::printSlabStats(Memory &mem) {
+    syncSlabs(mem);
 
-    worst->start += size;
-    worst->size -= size;
+    if (slabEnabled || !slabs.empty())
+        slabs.printStats();
+}
 
-    blocks.insert(worst, allocated);
-    if (worst->size == 0)
-        blocks.erase(worst);
+bool Allocator::compact(Memory &mem, MemSize need, CompactionResult &out) {
+    syncSlabs(mem);
 
-    std::cout << "Allocated (Worst Fit) id=" << allocated.id
-              << " at address=0x"
-              << std::hex << allocated.start << std::dec << "\n";
+    auto begin = std::chrono::steady_clock::now();
+    bool ok = mem.compact(need, out);
+    for (const std::pair<int, MemAddr> &move : out.moves) {
+        if (move.first < -1)
+            slabs.moveSlab(move.first, move.second);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (!ok)
+        return false;
 
-    return allocated.id;
+    compaction.runs++;
+    compaction.blocksMoved += out.blocksMoved;
+    compaction.bytesMoved += out.bytesMoved;
+    compaction.nanoseconds +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    return true;
 }
 
-void Allocator::freeBlock(Memory &mem, int id) {
-    auto &blocks = mem.getBlocks();
-
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (!it->free && it->id == id) {
-
-            // Mark block as free
-            it->free = true;
-            it->id = -1;
-
-            std::cout << "Block " << id << " freed\n";
-
-            // Merge with next block if free
-            auto next = it;
-            ++next;
-            if (next != blocks.end() && next->free) {
-                it->size += next->size;
-                blocks.erase(next);
-            }
-
-            // Merge with previous block if free
-            if (it != blocks.begin()) {
-                auto prev = it;
-                --prev;
-                if (prev->free) {
-                    prev->size += it->size;
-                    blocks.erase(it);
-                }
-            }
-
-            return;
-        }
-    }
+const CompactionStats &Allocator::getCompactionStats() const {
+    return compaction;
+}
 
-    std::cout << "Invalid free request: block id not found\n";
+void Allocator::printCompactionStats() const {
+    if (compaction.runs == 0)
+        return;
+
+    std::cout << "----- Compaction Stats -----\n";
+    std::cout << "Runs: " << compaction.runs << " (for failed mallocs: "
+              << compaction.automatic << ")\n";
+    std::cout << "Blocks moved: " << compaction.blocksMoved
+              << " | Bytes moved: " << compaction.bytesMoved << "\n";
+    std::cout << "Time: " << compaction.nanoseconds / 1000.0 << " us ("
+              << compaction.nanoseconds / 1000.0 / compaction.runs << " us per run)\n";
 }
@@ -0,0 +1,138 @@
+#include "../include/arena.h"
+
+RemoteFreeQueue::RemoteFreeQueue() : head(nullptr) {}
+
+RemoteFreeQueue::~RemoteFreeQueue() {
+    Node *node = head.load();
+    while (node) {
+        Node *next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+void RemoteFreeQueue::push(int id) {
+    Node *node = new Node{id, head.load(std::memory_order_relaxed)};
+    while (!head.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    }
+}
+
+bool RemoteFreeQueue::empty() const {
+    return head.load(std::memory_order_relaxed) == nullptr;
+}
+
+void RemoteFreeQueue::drain(std::vector<int> &out) {
+    Node *node = head.exchange(nullptr, std::memory_order_acquire);
+    while (node) {
+        Node *next = node->next;
+        out.push_back(node->id);
+        delete node;
+        node = next;
+    }
+}
+
+ConcurrentHeap::ConcurrentHeap(MemSize totalSize, int threads, AllocatorType strategy,
+                               MemSize largeThreshold)
+    : largeThreshold(largeThreshold) {
+    // The global arena keeps a quarter of the heap when there are
+    // per-thread arenas to share the rest
+    MemSize globalSize = threads > 0 ? totalSize / 4 : totalSize;
+    MemSize arenaSize = threads > 0 ? (totalSize - globalSize) / threads : 0;
+
+    MemAddr base = 0;
+    for (int i = 0; i <= threads; i++) {
+        MemSize size = i < threads ? arenaSize : globalSize;
+        std::unique_ptr<Arena> arena(new Arena());
+        arena->mem.init(size);
+        arena->alloc.setAllocator(strategy);
+        arena->base = base;
+        arena->stats = ArenaStats{0, 0, 0, 0, 0};
+        arenas.push_back(std::move(arena));
+        base += size;
+    }
+}
+
+// Frees the ids other threads queued for this arena; caller holds its lock
+void ConcurrentHeap::drainRemote(Arena &arena) {
+    std::vector<int> ids;
+    arena.remote.drain(ids);
+    for (int id : ids)
+        arena.alloc.release(arena.mem, id);
+    arena.stats.frees += ids.size();
+    arena.stats.remoteFrees += ids.size();
+}
+
+bool ConcurrentHeap::tryAllocate(int index, MemSize size, ArenaBlock &out) {
+    Arena &arena = *arenas[index];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    if (!arena.remote.empty())
+        drainRemote(arena);
+
+    AllocResult r = arena.alloc.allocate(arena.mem, size);
+    if (r.id == -1)
+        return false;
+
+    arena.stats.allocations++;
+    if (index == globalIndex() && index > 0)
+        arena.stats.fallbacks++;
+    out = ArenaBlock{index, r.id, arena.base + r.address};
+    return true;
+}
+
+ArenaBlock ConcurrentHeap::allocate(int thread, MemSize size) {
+    ArenaBlock block{-1, -1, -1};
+    int home = globalIndex() > 0 ? thread % globalIndex() : -1;
+
+    if (home != -1 && size < largeThreshold && tryAllocate(home, size, block))
+        return block;
+    if (tryAllocate(globalIndex(), size, block))
+        return block;
+
+    Arena &failed = home != -1 ? *arenas[home] : global();
+    std::lock_guard<std::mutex> guard(failed.lock);
+    failed.stats.failures++;
+    return block;
+}
+
+void ConcurrentHeap::release(int thread, const ArenaBlock &block) {
+    if (block.id == -1)
+        return;
+
+    int home = globalIndex() > 0 ? thread % globalIndex() : -1;
+    Arena &arena = *arenas[block.arena];
+
+    // Another thread's arena: leave it for the owner, without its lock
+    if (block.arena != home && block.arena != globalIndex()) {
+        arena.remote.push(block.id);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(arena.lock);
+    arena.alloc.release(arena.mem, block.id);
+    arena.stats.frees++;
+}
+
+int ConcurrentHeap::arenaCount() const {
+    return arenas.size();
+}
+
+void ConcurrentHeap::flushRemote() {
+    for (const std::unique_ptr<Arena> &arena : arenas) {
+        std::lock_guard<std::mutex> guard(arena->lock);
+        if (!arena->remote.empty())
+            drainRemote(*arena);
+    }
+}
+
+ArenaStats ConcurrentHeap::getStats() const {
+    ArenaStats total{0, 0, 0, 0, 0};
+    for (const std::unique_ptr<Arena> &arena : arenas) {
+        total.allocations += arena->stats.allocations;
+        total.frees += arena->stats.frees;
+        total.remoteFrees += arena->stats.remoteFrees;
+        total.fallbacks += arena->stats.fallbacks;
+        total.failures += arena->stats.failures;
+    }
+    return total;
+}
@@ -0,0 +1,95 @@
+#include "../include/block_table.h"
+
+BlockTable::BlockTable() {
+    head = NONE;
+    tail = NONE;
+    count = 0;
+}
+
+void BlockTable::clear() {
+    starts.clear();
+    sizes.clear();
+    ids.clear();
+    requesteds.clear();
+    states.clear();
+    prevs.clear();
+    nexts.clear();
+    emptySlots.clear();
+    head = NONE;
+    tail = NONE;
+    count = 0;
+}
+
+int BlockTable::newSlot(const Block &b) {
+    int slot;
+    if (!emptySlots.empty()) {
+        slot = emptySlots.back();
+        emptySlots.pop_back();
+    } else {
+        slot = (int)states.size();
+        starts.push_back(0);
+        sizes.push_back(0);
+        ids.push_back(0);
+        requesteds.push_back(0);
+        states.push_back(SLOT_EMPTY);
+        prevs.push_back(NONE);
+        nexts.push_back(NONE);
+    }
+
+    starts[slot] = b.start;
+    sizes[slot] = b.size;
+    ids[slot] = b.id;
+    requesteds[slot] = b.requested;
+    setFree(slot, b.free);
+    count++;
+    return slot;
+}
+
+int BlockTable::insertBefore(int slot, const Block &b) {
+    int s = newSlot(b);
+    int before = slot == NONE ? tail : prevs[slot];
+
+    prevs[s] = before;
+    nexts[s] = slot;
+
+    if (before != NONE)
+        nexts[before] = s;
+    else
+        head = s;
+
+    if (slot != NONE)
+        prevs[slot] = s;
+    else
+        tail = s;
+
+    return s;
+}
+
+void BlockTable::erase(int slot) {
+    int before = prevs[slot];
+    int after = nexts[slot];
+
+    if (before != NONE)
+        nexts[before] = after;
+    else
+        head = after;
+
+    if (after != NONE)
+        prevs[after] = before;
+    else
+        tail = before;
+
+    states[slot] = SLOT_EMPTY;
+    emptySlots.push_back(slot);
+    count--;
+}
+
+Block BlockTable::get(int slot) const {
+    Block b;
+    b.start = starts[slot];
+    b.size = sizes[slot];
+    b.free = isFree(slot);
+    b.id = ids[slot];
+    b.requested = requesteds[slot];
+    return b;
+}
@@ -0,0 +1,81 @@
+#include "../include/buddy.h"
+
+BuddyIndex::BuddyIndex() {
+    maxOrder = -1;
+}
+
+void BuddyIndex::reset(MemSize totalSize) {
+    clear();
+
+    maxOrder = -1;
+    while (maxOrder < MAX_ORDER && (1LL << (maxOrder + 1)) <= totalSize)
+        maxOrder++;
+
+    if (maxOrder < MIN_ORDER) {
+        maxOrder = -1;
+        return;
+    }
+
+    bitmaps.resize(maxOrder + 1);
+    freeStacks.resize(maxOrder + 1);
+}
+
+void BuddyIndex::clear() {
+    bitmaps.clear();
+    freeStacks.clear();
+    maxOrder = -1;
+}
+
+void BuddyIndex::add(MemAddr start, int order) {
+    MemAddr bit = start >> order;
+    bitmaps[order][bit / 64] |= 1ULL << (bit % 64);
+    freeStacks[order].push_back(start);
+}
+
+// Clears the free bit for a block, returns false if it was not free
+bool BuddyIndex::remove(MemAddr start, int order) {
+    if (start < 0)
+        return false;
+
+    MemAddr bit = start >> order;
+    SparseBitmap::iterator word = bitmaps[order].find(bit / 64);
+    if (word == bitmaps[order].end())
+        return false;
+
+    unsigned long long mask = 1ULL << (bit % 64);
+    if (!(word->second & mask))
+        return false;
+
+    word->second &= ~mask;
+    if (!word->second)
+        bitmaps[order].erase(word);
+    return true;
+}
+
+bool BuddyIndex::pop(int order, MemAddr &start) {
+    std::vector<MemAddr> &stack = freeStacks[order];
+
+    while (!stack.empty()) {
+        MemAddr candidate = stack.back();
+        stack.pop_back();
+
+        // Skip entries that were merged away since they were pushed
+        if (remove(candidate, order)) {
+            start = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+int BuddyIndex::getMaxOrder() const {
+    return maxOrder;
+}
+
+// Smallest order whose block holds size bytes
+int BuddyIndex::orderFor(MemSize size) {
+    int order = MIN_ORDER;
+    while (order < MAX_ORDER && (1LL << order) < size)
+        order++;
+    return order;
+}
@@ -1,86 +1,892 @@
 #include "../include/cache.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
-CacheLevel::CacheLevel(int cap) : capacity(cap) {}
 
-bool CacheLevel::contains(int key) {
-    return data.find(key) != data.end();
+static bool isNumber(const std::string &text) {
+    if (text.empty())
+        return false;
+    for (char c : text)
+        if (!isdigit((unsigned char)c))
+            return false;
+    return true;
 }
 
-int CacheLevel::get(int key) {
-    if (!contains(key))
+static bool isPowerOfTwo(int v) {
+    return v > 0 && (v & (v - 1)) == 0;
+}
+
+static int log2Of(int v) {
+    int shift = 0;
+    while ((1 << shift) < v)
+        shift++;
+    return shift;
+}
+
+bool parseCacheGeometry(const std::string &spec, CacheGeometry &geometry) {
+    if (isNumber(spec)) {
+        geometry.sets = 1;
+        geometry.ways = atoi(spec.c_str());
+        geometry.lineSize = 0;
+        return true;
+    }
+
+    std::vector<std::string> parts;
+    std::stringstream ss(spec);
+    std::string part;
+    while (getline(ss, part, 'x')) {
+        if (!isNumber(part))
+            return false;
+        parts.push_back(part);
+    }
+    if (parts.size() != 3)
+        return false;
+
+    geometry.sets = atoi(parts[0].c_str());
+    geometry.ways = atoi(parts[1].c_str());
+    geometry.lineSize = atoi(parts[2].c_str());
+
+    // One set of one-byte lines is just the fully associative cache
+    return isPowerOfTwo(geometry.sets) && geometry.ways > 0 &&
+           isPowerOfTwo(geometry.lineSize) && geometry.sets * geometry.lineSize >= 2;
+}
+
+std::string describeCacheGeometry(const CacheGeometry &geometry) {
+    if (geometry.lineSize == 0)
+        return std::to_string(geometry.ways);
+    return std::to_string(geometry.sets) + "x" + std::to_string(geometry.ways) +
+           "x" + std::to_string(geometry.lineSize);
+}
+
+CacheConfig defaultCacheConfig(int l1Size, int l2Size) {
+    CacheConfig config;
+    config.l1 = CacheGeometry{1, l1Size, 0};
+    config.l2 = CacheGeometry{1, l2Size, 0};
+    config.l1Policy = CACHE_FIFO;
+    config.l2Policy = CACHE_FIFO;
+    config.policyGiven = false;
+    config.writeBack = false;
+    config.writeAllocate = true;
+    config.inclusion = NON_INCLUSIVE;
+    config.prefetch = defaultPrefetchConfig();
+    return config;
+}
+
+bool parseCacheConfig(std::istream &args, CacheConfig &config, std::string &error) {
+    std::string l1Spec, l2Spec;
+    args >> l1Spec >> l2Spec;
+
+    config = defaultCacheConfig(0, 0);
+    if (!parseCacheGeometry(l1Spec, config.l1) || !parseCacheGeometry(l2Spec, config.l2)) {
+        error = "Invalid cache geometry";
+        return false;
+    }
+
+    // Remaining words: up to two policies (one for both levels, or one per
+    // level) and the write/inclusion modes, in any order
+    std::vector<CachePolicy> policies;
+    std::string word;
+    while (args >> word) {
+        CachePolicy policy;
+        if (parseCachePolicy(word, policy))
+            policies.push_back(policy);
+        else if (word == "write-back")
+            config.writeBack = true;
+        else if (word == "write-through")
+            config.writeBack = false;
+        else if (word == "write-allocate")
+            config.writeAllocate = true;
+        else if (word == "no-write-allocate")
+            config.writeAllocate = false;
+        else if (word == "inclusive")
+            config.inclusion = INCLUSIVE;
+        else if (word == "exclusive")
+            config.inclusion = EXCLUSIVE;
+        else if (word == "non-inclusive")
+            config.inclusion = NON_INCLUSIVE;
+        else if (parsePrefetchConfig(word, config.prefetch))
+            continue;
+        else {
+            error = "Unknown cache policy";
+            return false;
+        }
+    }
+
+    if (policies.size() > 2) {
+        error = "Unknown cache policy";
+        return false;
+    }
+    if (!policies.empty()) {
+        config.policyGiven = true;
+        config.l1Policy = policies[0];
+        config.l2Policy = policies.back();
+    }
+
+    int l1Words = config.l1.lineSize > 0 ? config.l1.lineSize : 1;
+    int l2Words = config.l2.lineSize > 0 ? config.l2.lineSize : 1;
+    if (config.inclusion == EXCLUSIVE && l1Words != l2Words) {
+        error = "Exclusive caches need the same line size";
+        return false;
+    }
+    return true;
+}
+
+std::string describeCacheConfig(const CacheConfig &config) {
+    std::string l1 = "L1=" + describeCacheGeometry(config.l1);
+    std::string l2 = "L2=" + describeCacheGeometry(config.l2);
+    if (config.policyGiven) {
+        l1 += std::string(" ") + cachePolicyName(config.l1Policy);
+        l2 += std::string(" ") + cachePolicyName(config.l2Policy);
+    }
+
+    std::string text = l1 + ", " + l2;
+    if (config.writeBack)
+        text += ", write-back";
+    if (!config.writeAllocate)
+        text += ", no-write-allocate";
+    if (config.inclusion == INCLUSIVE)
+        text += ", inclusive";
+    else if (config.inclusion == EXCLUSIVE)
+        text += ", exclusive";
+    if (config.prefetch.kind != PREFETCH_NONE)
+        text += ", prefetch " + describePrefetchConfig(config.prefetch);
+    return text;
+}
+
+
+
+int BackingMemory::read(MemAddr addr) const {
+    if (words.empty())
+        return (int)addr;
+    auto it = words.find(addr);
+    return it == words.end() ? (int)addr : it->second;
+}
+
+void BackingMemory::write(MemAddr addr, int value) {
+    words[addr] = value;
+}
+
+
+
+MissClassifier::MissClassifier(int capacity)
+    : capacity(capacity), lru(capacity), lines(capacity) {
+    for (int s = capacity - 1; s >= 0; s--)
+        emptySlots.push_back(s);
+}
+
+void MissClassifier::access(uint64_t line, bool missed, MissCounts &counts) {
+    // slotOf remembers every line ever seen; -1 = not resident
+    auto it = slotOf.find(line);
+    bool firstTouch = it == slotOf.end();
+    bool resident = !firstTouch && it->second != -1;
+
+    if (missed) {
+        if (firstTouch)
+            counts.compulsory++;
+        else if (!resident)
+            counts.capacity++;
+        else
+            counts.conflict++;
+    }
+
+    if (resident) {
+        lru.touched(it->second);
+        return;
+    }
+    if (capacity == 0)
+        return;
+
+    int slot;
+    if (!emptySlots.empty()) {
+        slot = emptySlots.back();
+        emptySlots.pop_back();
+    } else {
+        slot = lru.victim(line);
+        lru.removed(slot, lines[slot]);
+        slotOf[lines[slot]] = -1;
+    }
+
+    lines[slot] = line;
+    slotOf[line] = slot;
+    lru.inserted(slot, line);
+}
+
+
+
+CacheLevel::CacheLevel(int cap, CachePolicy kind)
+    : CacheLevel(CacheGeometry{1, cap, 0}, kind) {}
+
+CacheLevel::CacheLevel(const CacheGeometry &shape, CachePolicy kind)
+    : geometry(shape), capacity(0), policyType(kind),
+      lineShift(0), setShift(0), classifier(0), misses{0, 0, 0} {
+    if (geometry.ways < 0)
+        geometry.ways = 0;
+    capacity = geometry.sets * geometry.ways;
+    dirty.assign(capacity, 0);
+
+    if (!lineMode()) {
+        policies.push_back(makeReplacementPolicy(kind, capacity));
+        keys.resize(capacity);
+        values.resize(capacity);
+        evictedWords.resize(1);
+        for (int s = capacity - 1; s >= 0; s--)
+            emptySlots.push_back(s);
+        return;
+    }
+
+    lineShift = log2Of(geometry.lineSize);
+    setShift = log2Of(geometry.sets);
+    tags.assign(capacity, EMPTY_TAG);
+    lineData.assign((size_t)capacity * geometry.lineSize, 0);
+    evictedWords.resize(geometry.lineSize);
+    classifier = MissClassifier(capacity);
+
+    for (int s = 0; s < geometry.sets; s++)
+        policies.push_back(makeReplacementPolicy(kind, geometry.ways));
+}
+
+int CacheLevel::findWay(MemAddr key) const {
+    uint64_t line = lineOf(key);
+    int base = setOf(line) * geometry.ways;
+
+    int way = findInSet(&tags[base], tagOf(line));
+    return way == -1 ? -1 : base + way;
+}
+
+// Compares 4 (AVX2) or 2 (SSE2) 64-bit tags per instruction, then finishes
+// the set with scalar compares. Tags are unique within a set.
+int CacheLevel::findInSet(const MemAddr *setTags, MemAddr tag) const {
+    int ways = geometry.ways;
+    int w = 0;
+
+#if defined(__AVX2__)
+    __m256i needle4 = _mm256_set1_epi64x(tag);
+    for (; w + 4 <= ways; w += 4) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(setTags + w));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(chunk, needle4)));
+        if (mask)
+            return w + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    // SSE2 has no 64-bit compare: a lane matches when both of its halves do
+    __m128i needle2 = _mm_set1_epi64x(tag);
+    for (; w + 2 <= ways; w += 2) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(setTags + w));
+        __m128i halves = _mm_cmpeq_epi32(chunk, needle2);
+        __m128i both = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(both));
+        if (mask)
+            return w + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; w < ways; w++)
+        if (setTags[w] == tag)
+            return w;
+    return -1;
+}
+
+int CacheLevel::findSlot(MemAddr key) const {
+    if (lineMode())
+        return findWay(key);
+
+    auto it = slotOf.find(key);
+    return it == slotOf.end() ? -1 : it->second;
+}
+
+int *CacheLevel::slotWords(int slot) {
+    return lineMode() ? &lineData[(size_t)slot * geometry.lineSize] : &values[slot];
+}
+
+const int *CacheLevel::slotWords(int slot) const {
+    return lineMode() ? &lineData[(size_t)slot * geometry.lineSize] : &values[slot];
+}
+
+void CacheLevel::touchSlot(int slot) {
+    if (lineMode())
+        policies[slot / geometry.ways]->touched(slot % geometry.ways);
+    else
+        policies[0]->touched(slot);
+}
+
+void CacheLevel::saveEviction(int slot, CacheEviction *evicted) {
+    if (!evicted)
+        return;
+
+    const int *words = slotWords(slot);
+    std::copy(words, words + wordsPerLine(), evictedWords.begin());
+
+    evicted->count = wordsPerLine();
+    evicted->words = evictedWords.data();
+    evicted->dirty = dirty[slot] != 0;
+    if (lineMode()) {
+        int set = slot / geometry.ways;
+        uint64_t line = ((uint64_t)tags[slot] << setShift) | set;
+        evicted->first = (MemAddr)(line << lineShift);
+    } else {
+        evicted->first = keys[slot];
+    }
+}
+
+// Drops whatever is in `slot` and marks it empty
+void CacheLevel::releaseSlot(int slot) {
+    dirty[slot] = 0;
+
+    if (lineMode()) {
+        int set = slot / geometry.ways;
+        policies[set]->removed(slot % geometry.ways, tags[slot]);
+        tags[slot] = EMPTY_TAG;
+        return;
+    }
+
+    policies[0]->removed(slot, keys[slot]);
+    slotOf.erase(keys[slot]);
+    emptySlots.push_back(slot);
+}
+
+// Claims a slot for key, evicting if its set is full. Returns the slot, or
+// -1 for a level with no room at all.
+int CacheLevel::allocateSlot(MemAddr key, CacheEviction *evicted) {
+    if (capacity == 0)
+        return -1;
+
+    if (!lineMode()) {
+        int slot;
+        if (!emptySlots.empty()) {
+            slot = emptySlots.back();
+            emptySlots.pop_back();
+        } else {
+            slot = policies[0]->victim(key);
+            saveEviction(slot, evicted);
+            policies[0]->removed(slot, keys[slot]);
+            slotOf.erase(keys[slot]);
+        }
+
+        keys[slot] = key;
+        slotOf[key] = slot;
+        dirty[slot] = 0;
+        policies[0]->inserted(slot, key);
+        return slot;
+    }
+
+    uint64_t line = lineOf(key);
+    int set = setOf(line);
+    int base = set * geometry.ways;
+    MemAddr tag = tagOf(line);
+
+    int way = findInSet(&tags[base], EMPTY_TAG);
+    if (way == -1) {
+        way = policies[set]->victim(tag);
+        saveEviction(base + way, evicted);
+        policies[set]->removed(way, tags[base + way]);
+    }
+
+    tags[base + way] = tag;
+    dirty[base + way] = 0;
+    policies[set]->inserted(way, tag);
+    return base + way;
+}
+
+bool CacheLevel::contains(MemAddr key) const {
+    return findSlot(key) != -1;
+}
+
+bool CacheLevel::peek(MemAddr key, int &value) const {
+    int slot = findSlot(key);
+    if (slot == -1)
+        return false;
+
+    value = slotWords(slot)[wordIndex(key)];
+    return true;
+}
+
+bool CacheLevel::lookup(MemAddr key, int &value) {
+    int slot = findSlot(key);
+    if (lineMode())
+        classifier.access(lineOf(key), slot == -1, misses);
+    if (slot == -1)
+        return false;
+
+    touchSlot(slot);
+    value = slotWords(slot)[wordIndex(key)];
+    return true;
+}
+
+int CacheLevel::get(MemAddr key) {
+    int value;
+    if (!lookup(key, value))
         return -1;
-    return data[key];
+    return value;
+}
+
+bool CacheLevel::write(MemAddr key, int value, bool markDirty, bool touch) {
+    int slot = findSlot(key);
+    if (slot == -1)
+        return false;
+
+    slotWords(slot)[wordIndex(key)] = value;
+    if (markDirty)
+        dirty[slot] = 1;
+    if (touch)
+        touchSlot(slot);
+    return true;
 }
 
-void CacheLevel::put(int key, int value) {
-   
-    if (contains(key)) {
-        data[key] = value;
+void CacheLevel::put(MemAddr key, int value, const CacheLevel *source) {
+    if (write(key, value, false))
         return;
+
+    // Write-allocate: bring the rest of the line in first
+    fill(key, source);
+    write(key, value, false, false);
+}
+
+bool CacheLevel::fill(MemAddr key, const CacheLevel *source, const BackingMemory *memory,
+                      CacheEviction *evicted) {
+    CacheEviction scratch;
+    if (!evicted)
+        evicted = &scratch;
+    evicted->count = 0;
+
+    int slot = allocateSlot(key, evicted);
+    if (slot == -1)
+        return false;
+
+    int *words = slotWords(slot);
+    MemAddr first = firstAddress(key);
+    int count = wordsPerLine();
+
+    // A lower level with lines at least as large holds the whole line in one way
+    if (source && source->lineMode() && source->geometry.lineSize >= count) {
+        int from = source->findWay(key);
+        if (from != -1) {
+            int offset = (int)(first & (source->geometry.lineSize - 1));
+            const int *src = source->slotWords(from) + offset;
+            std::copy(src, src + count, words);
+            return evicted->count > 0;
+        }
+        source = nullptr;
     }
 
-    
-    if ((int)data.size() == capacity) {
-        int oldKey = fifo.front();
-        fifo.pop();
-        data.erase(oldKey);
+    for (int i = 0; i < count; i++) {
+        MemAddr addr = first + i;
+        if (!source || !source->peek(addr, words[i]))
+            words[i] = memory ? memory->read(addr) : (int)addr;
     }
+    return evicted->count > 0;
+}
 
-    data[key] = value;
-    fifo.push(key);
+bool CacheLevel::insertLine(MemAddr key, const int *words, bool isDirty, CacheEviction *evicted) {
+    evicted->count = 0;
+
+    int slot = findSlot(key);
+    if (slot == -1)
+        slot = allocateSlot(key, evicted);
+    if (slot == -1)
+        return false;
+
+    std::copy(words, words + wordsPerLine(), slotWords(slot));
+    dirty[slot] = isDirty;
+    return evicted->count > 0;
+}
+
+bool CacheLevel::invalidate(MemAddr key, CacheEviction *removed) {
+    int slot = findSlot(key);
+    if (slot == -1)
+        return false;
+
+    saveEviction(slot, removed);
+    releaseSlot(slot);
+    return true;
+}
+
+void CacheLevel::prefetch(MemAddr key) const {
+#if defined(__GNUC__)
+    if (lineMode() && geometry.ways > 0)
+        __builtin_prefetch(&tags[setOf(lineOf(key)) * geometry.ways]);
+#else
+    (void)key;
+#endif
+}
+
+CachePolicy CacheLevel::getPolicy() const {
+    return policyType;
+}
+
+bool CacheLevel::isSetAssociative() const {
+    return lineMode();
+}
+
+const MissCounts &CacheLevel::getMissCounts() const {
+    return misses;
 }
 
 void CacheLevel::display(const std::string& name) const {
-    std::cout << name << " Cache: ";
-    std::queue<int> temp = fifo;
+    std::vector<int> slots;
+
+    if (!lineMode()) {
+        std::cout << name << " Cache: ";
+        policies[0]->order(slots);
+
+        for (int slot : slots)
+            std::cout << "[" << keys[slot] << ":" << values[slot]
+                      << (dirty[slot] ? "*" : "") << "] ";
+        std::cout << "\n";
+        return;
+    }
+
+    std::cout << name << " Cache (" << geometry.sets << " sets x " << geometry.ways
+              << " ways, " << geometry.lineSize << "B lines):\n";
 
-    while (!temp.empty()) {
-        int key = temp.front();
-        temp.pop();
-        std::cout << "[" << key << ":" << data.at(key) << "] ";
+    for (int s = 0; s < geometry.sets; s++) {
+        slots.clear();
+        policies[s]->order(slots);
+        if (slots.empty())
+            continue;
+
+        std::cout << "  Set " << s << ": ";
+        for (int way : slots) {
+            int slot = s * geometry.ways + way;
+            uint64_t line = ((uint64_t)tags[slot] << setShift) | s;
+            std::cout << "[0x" << std::hex << (line << lineShift) << std::dec
+                      << (dirty[slot] ? "*" : "") << "] ";
+        }
+        std::cout << "\n";
     }
-    std::cout << "\n";
 }
 
 
 
-TwoLevelCache::TwoLevelCache(int l1Size, int l2Size)
-    : L1(l1Size), L2(l2Size),
+TwoLevelCache::TwoLevelCache(int l1Size, int l2Size,
+                             CachePolicy l1Policy, CachePolicy l2Policy)
+    : TwoLevelCache([&] {
+          CacheConfig config = defaultCacheConfig(l1Size, l2Size);
+          config.l1Policy = l1Policy;
+          config.l2Policy = l2Policy;
+          return config;
+      }()) {}
+
+TwoLevelCache::TwoLevelCache(const CacheConfig &config)
+    : L1(config.l1, config.l1Policy), L2(config.l2, config.l2Policy),
       l1Hits(0), l1Misses(0),
       l2Hits(0), l2Misses(0),
-      memoryAccesses(0) {}
+      memoryAccesses(0), memoryReads(0), memoryWrites(0),
+      bytesRead(0), bytesWritten(0), l1Writebacks(0), l2Writebacks(0),
+      prefetchesIssued(0), usefulPrefetches(0), pollutionMisses(0),
+      writeBack(config.writeBack), writeAllocate(config.writeAllocate),
+      inclusion(config.inclusion), prefetchConfig(config.prefetch),
+      prefetcher(makePrefetcher(config.prefetch)) {}
+
+void TwoLevelCache::writeToMemory(const int *words, MemAddr first, int count) {
+    for (int i = 0; i < count; i++)
+        memory.write(first + i, words[i]);
+    memoryWrites++;
+    bytesWritten += count;
+}
+
+// An L1 victim goes down to L2: the whole line when exclusive, otherwise
+// only its dirty data (straight to memory for parts L2 does not hold)
+void TwoLevelCache::evictedFromL1(const CacheEviction &e) {
+    if (inclusion == EXCLUSIVE) {
+        CacheEviction e2;
+        if (L2.insertLine(e.first, e.words, e.dirty, &e2))
+            evictedFromL2(e2);
+        else if (!L2.contains(e.first) && e.dirty)
+            writeToMemory(e.words, e.first, e.count);
+        return;
+    }
+
+    if (!e.dirty)
+        return;
+
+    l1Writebacks++;
+    int missed = 0;
+    for (int i = 0; i < e.count; i++) {
+        if (L2.write(e.first + i, e.words[i], true, false))
+            continue;
+        memory.write(e.first + i, e.words[i]);
+        missed++;
+    }
+    if (missed > 0) {
+        memoryWrites++;
+        bytesWritten += missed;
+    }
+}
+
+// An L2 victim is written back if dirty. Inclusive caches first pull the
+// matching lines out of L1, folding any newer L1 data into the writeback.
+void TwoLevelCache::evictedFromL2(CacheEviction e) {
+    if (inclusion == INCLUSIVE) {
+        int step = L1.wordsPerLine();
+        MemAddr start = e.first - (e.first & (step - 1));
+
+        for (MemAddr addr = start; addr < e.first + e.count; addr += step) {
+            CacheEviction e1;
+            if (!L1.invalidate(addr, &e1) || !e1.dirty)
+                continue;
+
+            l1Writebacks++;
+            for (int i = 0; i < e1.count; i++) {
+                MemAddr word = e1.first + i;
+                if (word >= e.first && word < e.first + e.count)
+                    e.words[word - e.first] = e1.words[i];
+                else if (!L2.write(word, e1.words[i], true, false))
+                    memory.write(word, e1.words[i]);
+            }
+            e.dirty = true;
+        }
+    }
+
+    if (prefetcher)
+        prefetchedLines.erase(l2LineOf(e.first));
+
+    if (!e.dirty)
+        return;
+
+    l2Writebacks++;
+    writeToMemory(e.words, e.first, e.count);
+}
+
+// L2 hit after an L1 miss: move the line up (exclusive) or copy it
+void TwoLevelCache::promote(MemAddr key) {
+    CacheEviction e;
+
+    if (inclusion == EXCLUSIVE) {
+        CacheEviction moved;
+        L2.invalidate(key, &moved);
+        if (L1.insertLine(key, moved.words, moved.dirty, &e))
+            evictedFromL1(e);
+        else if (!L1.contains(key) && moved.dirty)
+            writeToMemory(moved.words, moved.first, moved.count);
+        return;
+    }
+
+    if (L1.fill(key, &L2, &memory, &e))
+        evictedFromL1(e);
+}
+
+void TwoLevelCache::loadFromMemory(MemAddr key) {
+    memoryReads++;
+    bytesRead += inclusion == EXCLUSIVE ? L1.wordsPerLine() : L2.wordsPerLine();
+    installLine(key);
+}
+
+// Puts key's line in the hierarchy with the data now in memory
+void TwoLevelCache::installLine(MemAddr key) {
+    CacheEviction e;
+    if (prefetcher)
+        pollutedLines.erase(l2LineOf(key));
+
+    if (inclusion == EXCLUSIVE) {
+        if (L1.fill(key, nullptr, &memory, &e))
+            evictedFromL1(e);
+        return;
+    }
+
+    if (L2.fill(key, nullptr, &memory, &e))
+        evictedFromL2(e);
+    if (L1.fill(key, &L2, &memory, &e))
+        evictedFromL1(e);
+}
+
+// Write-allocate for write-back and exclusive caches: fetch like a read,
+// without touching the hit/miss counters
+void TwoLevelCache::bringIntoL1(MemAddr key) {
+    if (L1.contains(key))
+        return;
+    if (L2.contains(key))
+        promote(key);
+    else
+        loadFromMemory(key);
+}
 
-int TwoLevelCache::get(int key) {
-    
-    if (L1.contains(key)) {
+int TwoLevelCache::access(MemAddr key, int &level) {
+    int value;
+
+    if (L1.lookup(key, value)) {
         l1Hits++;
-        return L1.get(key);
+        level = HIT_L1;
+        return value;
     }
 
     l1Misses++;
 
-   
-    if (L2.contains(key)) {
+    if (L2.lookup(key, value)) {
         l2Hits++;
-        int value = L2.get(key);
-        L1.put(key, value); 
+        bool firstUse = prefetcher && prefetchedLines.erase(l2LineOf(key)) > 0;
+        if (firstUse)
+            usefulPrefetches++;
+        promote(key);
+        runPrefetcher(key, firstUse);
+        level = HIT_L2;
         return value;
     }
 
     l2Misses++;
+    if (prefetcher) {
+        uint64_t line = l2LineOf(key);
+        if (pollutedLines.erase(line))
+            pollutionMisses++;
+
+        // A stream buffer holding the line supplies it without a new fetch
+        if (prefetcher->claim(line)) {
+            usefulPrefetches++;
+            installLine(key);
+            value = memory.read(key);
+            runPrefetcher(key, true);
+            level = HIT_L2;
+            return value;
+        }
+    }
+
     memoryAccesses++;
-    int value = key;
-    L2.put(key, value);
-    L1.put(key, value);
-    return value; 
+    loadFromMemory(key);
+    value = memory.read(key);
+    runPrefetcher(key, true);
+    level = HIT_MEMORY;
+    return value;
+}
+
+void TwoLevelCache::runPrefetcher(MemAddr key, bool trigger) {
+    if (!prefetcher)
+        return;
+
+    prefetchQueue.clear();
+    prefetcher->access(l2LineOf(key), trigger, prefetchQueue);
+
+    if (prefetcher->buffered()) {
+        long long n = prefetchQueue.size();
+        prefetchesIssued += n;
+        memoryReads += n;
+        bytesRead += n * L2.wordsPerLine();
+        return;
+    }
+
+    for (uint64_t line : prefetchQueue)
+        prefetchLine(line);
 }
 
-void TwoLevelCache::put(int key, int value) {
-    L1.put(key, value);
-    L2.put(key, value);
+// Fetches a line into L2 unless the hierarchy already has it. Whatever it
+// evicts is remembered so a later demand miss on it counts as pollution.
+void TwoLevelCache::prefetchLine(uint64_t line) {
+    if (line > (uint64_t)INT64_MAX / L2.wordsPerLine())
+        return;
+
+    MemAddr key = (MemAddr)(line * L2.wordsPerLine());
+    if (L2.contains(key) || (inclusion == EXCLUSIVE && L1.contains(key)))
+        return;
+
+    CacheEviction e;
+    bool evicted = L2.fill(key, nullptr, &memory, &e);
+    if (!L2.contains(key))
+        return;
+
+    prefetchesIssued++;
+    memoryReads++;
+    bytesRead += L2.wordsPerLine();
+    pollutedLines.erase(line);
+    prefetchedLines.insert(line);
+
+    if (evicted) {
+        pollutedLines.insert(l2LineOf(e.first));
+        evictedFromL2(e);
+    }
+}
+int TwoLevelCache::get(MemAddr key) {
+    int level;
+    return access(key, level);
+}
+
+void TwoLevelCache::getBatch(const MemAddr *addrs, size_t n, CacheResult *out) {
+    const size_t BLOCK = 16;
+
+    for (size_t i = 0; i < n; i += BLOCK) {
+        size_t end = std::min(n, i + BLOCK);
+
+        // Accesses still run in order, so results match get() exactly;
+        // the block's tag sets are just already on their way in
+        for (size_t j = i; j < end; j++) {
+            L1.prefetch(addrs[j]);
+            L2.prefetch(addrs[j]);
+        }
+
+        for (size_t j = i; j < end; j++)
+            out[j].value = access(addrs[j], out[j].level);
+    }
+}
+
+CacheStats TwoLevelCache::getStats() const {
+    CacheStats s;
+    s.l1Hits = l1Hits;
+    s.l1Misses = l1Misses;
+    s.l2Hits = l2Hits;
+    s.l2Misses = l2Misses;
+    s.memoryAccesses = memoryAccesses;
+    s.l1Types = L1.getMissCounts();
+    s.l2Types = L2.getMissCounts();
+    s.memoryReads = memoryReads;
+    s.memoryWrites = memoryWrites;
+    s.bytesRead = bytesRead;
+    s.bytesWritten = bytesWritten;
+    s.l1Writebacks = l1Writebacks;
+    s.l2Writebacks = l2Writebacks;
+    s.prefetchesIssued = prefetchesIssued;
+    s.usefulPrefetches = usefulPrefetches;
+    s.pollutionMisses = pollutionMisses;
+    return s;
+}
+
+void TwoLevelCache::put(MemAddr key, int value) {
+    if (writeBack) {
+        if (L1.write(key, value, true))
+            return;
+        if (writeAllocate) {
+            bringIntoL1(key);
+            if (L1.write(key, value, true, false))
+                return;
+        }
+        if (!L2.write(key, value, true, !writeAllocate))
+            writeToMemory(&value, key, 1);
+        return;
+    }
+
+    // Write-through: every copy is updated and memory always gets the store
+    if (inclusion == EXCLUSIVE) {
+        if (!L1.write(key, value, false) && !L2.write(key, value, false) && writeAllocate) {
+            bringIntoL1(key);
+            L1.write(key, value, false, false);
+        }
+    } else {
+        CacheEviction e;
+        if (!L2.write(key, value, false) && writeAllocate) {
+            if (L2.wordsPerLine() > 1) {
+                memoryReads++;
+                bytesRead += L2.wordsPerLine();
+            }
+            if (prefetcher)
+                pollutedLines.erase(l2LineOf(key));
+            if (L2.fill(key, nullptr, &memory, &e))
+                evictedFromL2(e);
+            L2.write(key, value, false, false);
+        }
+        if (!L1.write(key, value, false) && writeAllocate) {
+            if (L1.fill(key, &L2, &memory, &e))
+                evictedFromL1(e);
+            L1.write(key, value, false, false);
+        }
+    }
+    writeToMemory(&value, key, 1);
 }
 
 void TwoLevelCache::display() const {
@@ -93,4 +899,33 @@ void TwoLevelCache::stats() const {
     std::cout << "L1 Hits: " << l1Hits << " | L1 Misses: " << l1Misses << "\n";
     std::cout << "L2 Hits: " << l2Hits << " | L2 Misses: " << l2Misses << "\n";
     std::cout << "Main Memory Accesses: " << memoryAccesses << "\n";
+    std::cout << "Memory Reads: " << memoryReads << " | Memory Writes: " << memoryWrites << "\n";
+    if (L1.isSetAssociative() || L2.isSetAssociative())
+        std::cout << "Memory Traffic: " << bytesRead << " B read, "
+                  << bytesWritten << " B written\n";
+    if (writeBack)
+        std::cout << "Writebacks: L1=" << l1Writebacks << ", L2=" << l2Writebacks << "\n";
+
+    if (prefetcher) {
+        // Coverage: share of the L2 misses that would have gone to memory
+        // which a prefetch served instead
+        long long wouldMiss = usefulPrefetches + memoryAccesses;
+        std::cout << "Prefetcher (" << describePrefetchConfig(prefetchConfig)
+                  << "): issued=" << prefetchesIssued << ", useful=" << usefulPrefetches
+                  << ", pollution=" << pollutionMisses << "\n";
+        std::cout << "Prefetch Accuracy: "
+                  << (prefetchesIssued ? 100.0 * usefulPrefetches / prefetchesIssued : 0.0)
+                  << "% | Coverage: "
+                  << (wouldMiss ? 100.0 * usefulPrefetches / wouldMiss : 0.0) << "%\n";
+    }
+
+    const CacheLevel *levels[] = {&L1, &L2};
+    const char *names[] = {"L1", "L2"};
+    for (int i = 0; i < 2; i++) {
+        if (!levels[i]->isSetAssociative())
+            continue;
+        const MissCounts &m = levels[i]->getMissCounts();
+        std::cout << names[i] << " Miss Types: compulsory=" << m.compulsory
+                  << ", capacity=" << m.capacity << ", conflict=" << m.conflict << "\n";
+    }
 }
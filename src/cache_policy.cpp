@@ -0,0 +1,324 @@
+#include "../include/cache_policy.h"
+#include <algorithm>
+
+bool parseCachePolicy(const std::string &name, CachePolicy &policy) {
+    if (name == "fifo")
+        policy = CACHE_FIFO;
+    else if (name == "lru")
+        policy = CACHE_LRU;
+    else if (name == "lfu")
+        policy = CACHE_LFU;
+    else if (name == "clock")
+        policy = CACHE_CLOCK;
+    else if (name == "arc")
+        policy = CACHE_ARC;
+    else
+        return false;
+    return true;
+}
+
+const char *cachePolicyName(CachePolicy policy) {
+    switch (policy) {
+    case CACHE_LRU:
+        return "LRU";
+    case CACHE_LFU:
+        return "LFU";
+    case CACHE_CLOCK:
+        return "CLOCK";
+    case CACHE_ARC:
+        return "ARC";
+    default:
+        return "FIFO";
+    }
+}
+
+std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(CachePolicy policy, int capacity) {
+    switch (policy) {
+    case CACHE_LRU:
+        return std::unique_ptr<ReplacementPolicy>(new LruPolicy(capacity));
+    case CACHE_LFU:
+        return std::unique_ptr<ReplacementPolicy>(new LfuPolicy(capacity));
+    case CACHE_CLOCK:
+        return std::unique_ptr<ReplacementPolicy>(new ClockPolicy(capacity));
+    case CACHE_ARC:
+        return std::unique_ptr<ReplacementPolicy>(new ArcPolicy(capacity));
+    default:
+        return std::unique_ptr<ReplacementPolicy>(new FifoPolicy(capacity));
+    }
+}
+
+// ---------- Slot lists ----------
+
+SlotLinks::SlotLinks(int capacity)
+    : prevs(capacity, -1), nexts(capacity, -1) {}
+
+void SlotLinks::pushBack(SlotList &list, int slot) {
+    prevs[slot] = list.tail;
+    nexts[slot] = -1;
+
+    if (list.tail != -1)
+        nexts[list.tail] = slot;
+    else
+        list.head = slot;
+
+    list.tail = slot;
+    list.size++;
+}
+
+void SlotLinks::unlink(SlotList &list, int slot) {
+    if (prevs[slot] != -1)
+        nexts[prevs[slot]] = nexts[slot];
+    else
+        list.head = nexts[slot];
+
+    if (nexts[slot] != -1)
+        prevs[nexts[slot]] = prevs[slot];
+    else
+        list.tail = prevs[slot];
+
+    prevs[slot] = nexts[slot] = -1;
+    list.size--;
+}
+
+static void appendList(const SlotLinks &links, const SlotList &list, std::vector<int> &slots) {
+    for (int s = list.head; s != -1; s = links.next(s))
+        slots.push_back(s);
+}
+
+// ---------- FIFO ----------
+
+FifoPolicy::FifoPolicy(int capacity) : links(capacity) {}
+
+void FifoPolicy::inserted(int slot, MemAddr) {
+    links.pushBack(queue, slot);
+}
+
+void FifoPolicy::touched(int) {}
+
+void FifoPolicy::removed(int slot, MemAddr) {
+    links.unlink(queue, slot);
+}
+
+int FifoPolicy::victim(MemAddr) {
+    return queue.head;
+}
+
+void FifoPolicy::order(std::vector<int> &slots) const {
+    appendList(links, queue, slots);
+}
+
+// ---------- LRU ----------
+
+LruPolicy::LruPolicy(int capacity) : links(capacity) {}
+
+void LruPolicy::inserted(int slot, MemAddr) {
+    links.pushBack(recency, slot);
+}
+
+void LruPolicy::touched(int slot) {
+    links.unlink(recency, slot);
+    links.pushBack(recency, slot);
+}
+
+void LruPolicy::removed(int slot, MemAddr) {
+    links.unlink(recency, slot);
+}
+
+int LruPolicy::victim(MemAddr) {
+    return recency.head;
+}
+
+void LruPolicy::order(std::vector<int> &slots) const {
+    appendList(links, recency, slots);
+}
+
+// ---------- LFU ----------
+
+LfuPolicy::LfuPolicy(int capacity)
+    : links(capacity), counts(capacity, 0), minCount(1) {}
+
+void LfuPolicy::unlinkFromBucket(int slot) {
+    auto it = buckets.find(counts[slot]);
+    links.unlink(it->second, slot);
+    if (it->second.size == 0)
+        buckets.erase(it);
+}
+
+void LfuPolicy::inserted(int slot, MemAddr) {
+    counts[slot] = 1;
+    links.pushBack(buckets[1], slot);
+    minCount = 1;
+}
+
+void LfuPolicy::touched(int slot) {
+    int count = counts[slot];
+    unlinkFromBucket(slot);
+    if (count == minCount && buckets.find(count) == buckets.end())
+        minCount = count + 1;
+
+    counts[slot] = count + 1;
+    links.pushBack(buckets[count + 1], slot);
+}
+
+void LfuPolicy::removed(int slot, MemAddr) {
+    unlinkFromBucket(slot);
+    counts[slot] = 0;
+}
+
+int LfuPolicy::victim(MemAddr) {
+    // minCount never overshoots the smallest live count, so this only
+    // walks forward after an explicit remove emptied the lowest bucket
+    while (buckets.find(minCount) == buckets.end())
+        minCount++;
+    return buckets[minCount].head;
+}
+
+void LfuPolicy::order(std::vector<int> &slots) const {
+    std::vector<int> keys;
+    for (const auto &bucket : buckets)
+        keys.push_back(bucket.first);
+    std::sort(keys.begin(), keys.end());
+
+    for (int count : keys)
+        appendList(links, buckets.at(count), slots);
+}
+
+// ---------- CLOCK ----------
+
+ClockPolicy::ClockPolicy(int capacity)
+    : referenced(capacity, 0), used(capacity, 0), hand(0) {}
+
+void ClockPolicy::inserted(int slot, MemAddr) {
+    used[slot] = 1;
+    referenced[slot] = 1;
+}
+
+void ClockPolicy::touched(int slot) {
+    referenced[slot] = 1;
+}
+
+void ClockPolicy::removed(int slot, MemAddr) {
+    used[slot] = 0;
+    referenced[slot] = 0;
+}
+
+int ClockPolicy::victim(MemAddr) {
+    int n = referenced.size();
+    while (true) {
+        int slot = hand;
+        hand = (hand + 1) % n;
+
+        if (!used[slot])
+            continue;
+        if (!referenced[slot])
+            return slot;
+        referenced[slot] = 0;
+    }
+}
+
+void ClockPolicy::order(std::vector<int> &slots) const {
+    int n = used.size();
+    for (int i = 0; i < n; i++) {
+        int slot = (hand + i) % n;
+        if (used[slot])
+            slots.push_back(slot);
+    }
+}
+
+// ---------- ARC ----------
+
+ArcPolicy::ArcPolicy(int capacity)
+    : capacity(capacity), target(0), links(capacity), inT2(capacity, 0),
+      adapted(false), adaptedKey(0) {}
+
+// Ghost hit: grow the list that would have kept the key
+void ArcPolicy::adapt(MemAddr key) {
+    auto it = ghosts.find(key);
+    if (it == ghosts.end())
+        return;
+
+    int sizeB1 = b1.size();
+    int sizeB2 = b2.size();
+
+    if (it->second.inB2)
+        target = std::max(0, target - std::max(1, sizeB1 / sizeB2));
+    else
+        target = std::min(capacity, target + std::max(1, sizeB2 / sizeB1));
+}
+
+void ArcPolicy::dropGhost(std::list<MemAddr> &list) {
+    ghosts.erase(list.front());
+    list.pop_front();
+}
+
+void ArcPolicy::remember(MemAddr key, bool toB2) {
+    std::list<MemAddr> &list = toB2 ? b2 : b1;
+    list.push_back(key);
+
+    Ghost ghost;
+    ghost.pos = std::prev(list.end());
+    ghost.inB2 = toB2;
+    ghosts[key] = ghost;
+}
+
+int ArcPolicy::victim(MemAddr incomingKey) {
+    adapt(incomingKey);
+    adapted = true;
+    adaptedKey = incomingKey;
+
+    auto it = ghosts.find(incomingKey);
+    bool hitB2 = it != ghosts.end() && it->second.inB2;
+
+    if (t1.size > 0 && (t1.size > target || (hitB2 && t1.size == target)))
+        return t1.head;
+    if (t2.size > 0)
+        return t2.head;
+    return t1.head;
+}
+
+void ArcPolicy::inserted(int slot, MemAddr key) {
+    if (!adapted || adaptedKey != key)
+        adapt(key);
+    adapted = false;
+
+    auto it = ghosts.find(key);
+    if (it != ghosts.end()) {
+        (it->second.inB2 ? b2 : b1).erase(it->second.pos);
+        ghosts.erase(it);
+
+        inT2[slot] = 1;
+        links.pushBack(t2, slot);
+        return;
+    }
+
+    inT2[slot] = 0;
+    links.pushBack(t1, slot);
+
+    // Keep |T1| + |B1| <= c and the whole directory <= 2c
+    while (t1.size + (int)b1.size() > capacity && !b1.empty())
+        dropGhost(b1);
+    while (t1.size + t2.size + (int)(b1.size() + b2.size()) > 2 * capacity && !b2.empty())
+        dropGhost(b2);
+}
+
+void ArcPolicy::touched(int slot) {
+    if (inT2[slot]) {
+        links.unlink(t2, slot);
+    } else {
+        links.unlink(t1, slot);
+        inT2[slot] = 1;
+    }
+    links.pushBack(t2, slot);
+}
+
+void ArcPolicy::removed(int slot, MemAddr key) {
+    bool fromT2 = inT2[slot];
+    links.unlink(fromT2 ? t2 : t1, slot);
+    inT2[slot] = 0;
+    remember(key, fromT2);
+}
+
+void ArcPolicy::order(std::vector<int> &slots) const {
+    appendList(links, t1, slots);
+    appendList(links, t2, slots);
+}
@@ -0,0 +1,381 @@
+#include "../include/coherence.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+static int log2Of(int n) {
+    int shift = 0;
+    while ((1 << shift) < n)
+        shift++;
+    return shift;
+}
+
+EpochBarrier::EpochBarrier(int parties)
+    : parties(parties), waiting(0), generation(0) {}
+
+MultiCoreCache::MultiCoreCache(int count, const CacheGeometry &l1, const CacheGeometry &l2,
+                               CachePolicy policy)
+    : l1Geometry(l1), cores(count), L2(l2, policy), bus{0, 0, 0, 0, 0, 0, 0} {
+    lineShift = log2Of(l1.lineSize);
+    setShift = log2Of(l1.sets);
+    // 64 bits per line: one per 4-byte word, or per chunk for lines over 256 B
+    wordShift = std::max(log2Of(WORD_SIZE), lineShift - 6);
+
+    int slots = l1.sets * l1.ways;
+    for (Core &core : cores) {
+        core.lines.assign(slots, 0);
+        core.states.assign(slots, MESI_INVALID);
+        core.written.assign(slots, 0);
+        for (int s = 0; s < l1.sets; s++)
+            core.policies.push_back(makeReplacementPolicy(policy, l1.ways));
+        core.stats = CoreStats{0, 0, 0, 0, 0, 0};
+        core.position = 0;
+        core.pending = false;
+    }
+}
+
+uint64_t MultiCoreCache::wordBit(MemAddr addr) const {
+    int offset = (int)(addr & (l1Geometry.lineSize - 1));
+    return 1ULL << ((offset >> wordShift) & 63);
+}
+
+int MultiCoreCache::findSlot(const Core &core, uint64_t line) const {
+    int base = (int)(line & (l1Geometry.sets - 1)) * l1Geometry.ways;
+    for (int w = 0; w < l1Geometry.ways; w++)
+        if (core.states[base + w] != MESI_INVALID && core.lines[base + w] == line)
+            return base + w;
+    return -1;
+}
+
+void MultiCoreCache::invalidateSlot(Core &core, int slot) {
+    int set = slot / l1Geometry.ways;
+    core.policies[set]->removed(slot % l1Geometry.ways, (MemAddr)(core.lines[slot] >> setShift));
+    core.states[slot] = MESI_INVALID;
+    core.written[slot] = 0;
+}
+
+void MultiCoreCache::writeBackLine(uint64_t line) {
+    bus.writebacks++;
+    MemAddr addr = (MemAddr)(line << lineShift);
+    if (!L2.contains(addr))
+        L2.fill(addr, nullptr);
+}
+
+// Claims a way for `line`, writing back a modified victim
+int MultiCoreCache::allocateSlot(Core &core, uint64_t line) {
+    int set = (int)(line & (l1Geometry.sets - 1));
+    int base = set * l1Geometry.ways;
+    MemAddr tag = (MemAddr)(line >> setShift);
+
+    int way = -1;
+    for (int w = 0; w < l1Geometry.ways && way == -1; w++)
+        if (core.states[base + w] == MESI_INVALID)
+            way = w;
+
+    if (way == -1) {
+        way = core.policies[set]->victim(tag);
+        if (core.states[base + way] == MESI_MODIFIED)
+            writeBackLine(core.lines[base + way]);
+        invalidateSlot(core, base + way);
+    }
+
+    core.lines[base + way] = line;
+    core.policies[set]->inserted(way, tag);
+    return base + way;
+}
+
+// Parallel phase: an access the core can finish without the bus. Touches
+// only this core's state.
+bool MultiCoreCache::tryLocal(Core &core, const CoreAccess &a) {
+    int slot = findSlot(core, lineOf(a.addr));
+    if (slot == -1)
+        return false;
+    if (a.write && core.states[slot] == MESI_SHARED)
+        return false;   // needs an upgrade
+
+    if (a.write) {
+        core.states[slot] = MESI_MODIFIED;     // E -> M is silent
+        core.written[slot] |= wordBit(a.addr);
+        core.stats.writes++;
+    } else {
+        core.stats.reads++;
+    }
+
+    core.stats.hits++;
+    core.policies[slot / l1Geometry.ways]->touched(slot % l1Geometry.ways);
+    return true;
+}
+
+// Serial phase: BusUpgr for a write to a shared line, otherwise BusRd or
+// BusRdX for a miss, snooped by every other core
+void MultiCoreCache::busTransaction(int id, const CoreAccess &a) {
+    Core &core = cores[id];
+    uint64_t line = lineOf(a.addr);
+    uint64_t bit = wordBit(a.addr);
+
+    if (a.write)
+        core.stats.writes++;
+    else
+        core.stats.reads++;
+
+    int slot = findSlot(core, line);
+    bool upgrade = slot != -1;
+
+    if (upgrade) {
+        bus.upgrades++;
+        core.stats.hits++;
+    } else {
+        core.stats.misses++;
+
+        // A coherence miss is true sharing if some other core wrote the
+        // word we need since our copy was invalidated
+        auto it = core.invalidated.find(line);
+        if (it != core.invalidated.end()) {
+            uint64_t remote = it->second;
+            for (size_t c = 0; c < cores.size(); c++) {
+                int other = c == (size_t)id ? -1 : findSlot(cores[c], line);
+                if (other != -1)
+                    remote |= cores[c].written[other];
+            }
+            core.stats.coherenceMisses++;
+            if (!(remote & bit))
+                core.stats.falseSharing++;
+            core.invalidated.erase(it);
+        }
+    }
+
+    bool shared = false, supplied = false;
+    for (size_t c = 0; c < cores.size(); c++) {
+        if (c == (size_t)id)
+            continue;
+        Core &other = cores[c];
+
+        int s = findSlot(other, line);
+        if (s == -1) {
+            // Already invalid there: remember this write for its next miss
+            if (a.write) {
+                auto it = other.invalidated.find(line);
+                if (it != other.invalidated.end())
+                    it->second |= bit;
+            }
+            continue;
+        }
+
+        supplied = true;
+        if (other.states[s] == MESI_MODIFIED)
+            writeBackLine(line);
+
+        if (a.write) {
+            invalidateSlot(other, s);
+            other.invalidated[line] = bit;
+            bus.invalidations++;
+        } else {
+            other.states[s] = MESI_SHARED;
+            shared = true;
+        }
+    }
+
+    if (upgrade) {
+        core.states[slot] = MESI_MODIFIED;
+        core.written[slot] |= bit;
+        core.policies[slot / l1Geometry.ways]->touched(slot % l1Geometry.ways);
+        return;
+    }
+
+    if (supplied) {
+        bus.cacheToCache++;
+    } else {
+        int value;
+        if (L2.lookup(a.addr, value)) {
+            bus.l2Hits++;
+        } else {
+            bus.l2Misses++;
+            L2.fill(a.addr, nullptr);
+        }
+    }
+
+    slot = allocateSlot(core, line);
+    core.states[slot] = a.write ? MESI_MODIFIED : (shared ? MESI_SHARED : MESI_EXCLUSIVE);
+    core.written[slot] = a.write ? bit : 0;
+}
+
+void MultiCoreCache::run(const std::vector<std::vector<CoreAccess>> &streams,
+                         int threads, int epochLength) {
+    int n = cores.size();
+    threads = std::max(1, std::min(threads, n));
+    epochLength = std::max(1, epochLength);
+    bool done = false;
+
+    // Runs on the last thread to reach the barrier, while the rest wait
+    auto serialPhase = [&]() {
+        bus.epochs++;
+        done = true;
+        for (int c = 0; c < n; c++) {
+            Core &core = cores[c];
+            if (core.pending) {
+                busTransaction(c, streams[c][core.position]);
+                core.position++;
+                core.pending = false;
+            }
+            if (core.position < streams[c].size())
+                done = false;
+        }
+    };
+
+    EpochBarrier barrier(threads);
+    auto worker = [&](int first) {
+        while (true) {
+            for (int c = first; c < n; c += threads) {
+                Core &core = cores[c];
+                const std::vector<CoreAccess> &stream = streams[c];
+                for (int i = 0; i < epochLength && core.position < stream.size(); i++) {
+                    if (!tryLocal(core, stream[core.position])) {
+                        core.pending = true;
+                        break;
+                    }
+                    core.position++;
+                }
+            }
+
+            barrier.wait(serialPhase);
+            if (done)
+                return;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++)
+        pool.emplace_back(worker, t);
+    worker(0);
+    for (std::thread &t : pool)
+        t.join();
+}
+
+const CoreStats &MultiCoreCache::getCoreStats(int core) const {
+    return cores[core].stats;
+}
+
+CoreStats MultiCoreCache::getTotals() const {
+    CoreStats total{0, 0, 0, 0, 0, 0};
+    for (const Core &core : cores) {
+        total.reads += core.stats.reads;
+        total.writes += core.stats.writes;
+        total.hits += core.stats.hits;
+        total.misses += core.stats.misses;
+        total.coherenceMisses += core.stats.coherenceMisses;
+        total.falseSharing += core.stats.falseSharing;
+    }
+    return total;
+}
+
+const CoherenceStats &MultiCoreCache::getCoherenceStats() const {
+    return bus;
+}
+
+void MultiCoreCache::stats() const {
+    std::cout << "----- Multi-Core Cache Statistics -----\n";
+    for (size_t c = 0; c < cores.size(); c++) {
+        const CoreStats &s = cores[c].stats;
+        std::cout << "Core " << c << ": reads=" << s.reads << ", writes=" << s.writes
+                  << ", hits=" << s.hits << ", misses=" << s.misses
+                  << ", coherence misses=" << s.coherenceMisses
+                  << ", false sharing=" << s.falseSharing << "\n";
+    }
+
+    CoreStats t = getTotals();
+    long long accesses = t.reads + t.writes;
+    std::cout << "L1 Hits: " << t.hits << " | L1 Misses: " << t.misses;
+    if (accesses > 0)
+        std::cout << " (hit ratio " << 100.0 * t.hits / accesses << "%)";
+    std::cout << "\n";
+    std::cout << "L2 Hits: " << bus.l2Hits << " | L2 Misses: " << bus.l2Misses << "\n";
+    std::cout << "Invalidations: " << bus.invalidations << " | Upgrades: " << bus.upgrades << "\n";
+    std::cout << "Coherence Misses: " << t.coherenceMisses
+              << " (false sharing: " << t.falseSharing << ")\n";
+    std::cout << "Cache-to-Cache Transfers: " << bus.cacheToCache
+              << " | Writebacks: " << bus.writebacks << "\n";
+    std::cout << "Epochs: " << bus.epochs << "\n";
+}
+
+bool loadCoreTrace(const std::string &path, int cores,
+                   std::vector<std::vector<CoreAccess>> &streams, std::string &error) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    streams.assign(cores, std::vector<CoreAccess>());
+    std::string line, op, addr;
+    int lineNo = 0;
+    while (getline(in, line)) {
+        lineNo++;
+        std::stringstream ss(line);
+        int core;
+        if (!(ss >> core))
+            continue;       // blank or comment
+
+        char *end = nullptr;
+        long long value = -1;
+        if (ss >> op >> addr)
+            value = strtoll(addr.c_str(), &end, 0);
+
+        if (!end || *end != '\0' || value < 0 || (op != "r" && op != "w") ||
+            core < 0 || core >= cores) {
+            error = "bad record on line " + std::to_string(lineNo);
+            return false;
+        }
+
+        CoreAccess a;
+        a.addr = value;
+        a.write = op == "w";
+        streams[core].push_back(a);
+    }
+    return true;
+}
+
+int runMultiCore(const std::string &path, int cores, const std::string &l1Spec,
+                 const std::string &l2Spec, const std::string &policyName,
+                 int threads, int epochLength) {
+    CacheGeometry l1, l2;
+    CachePolicy policy;
+    if (!parseCacheGeometry(l1Spec, l1) || !parseCacheGeometry(l2Spec, l2) || l1.lineSize == 0) {
+        std::cout << "Invalid cache geometry (L1 needs <sets>x<ways>x<line>)\n";
+        return 1;
+    }
+    if (!parseCachePolicy(policyName, policy)) {
+        std::cout << "Unknown cache policy\n";
+        return 1;
+    }
+    if (cores < 1) {
+        std::cout << "Invalid core count\n";
+        return 1;
+    }
+
+    std::vector<std::vector<CoreAccess>> streams;
+    std::string error;
+    if (!loadCoreTrace(path, cores, streams, error)) {
+        std::cout << "Multi-core run failed: " << error << "\n";
+        return 1;
+    }
+
+    MultiCoreCache cache(cores, l1, l2, policy);
+    auto begin = std::chrono::steady_clock::now();
+    cache.run(streams, threads, epochLength);
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+
+    CoreStats total = cache.getTotals();
+    long long accesses = total.reads + total.writes;
+    std::cout << "Cores: " << cores << " | Threads: " << std::max(1, std::min(threads, cores))
+              << " | Accesses: " << accesses << "\n";
+    std::cout << "Elapsed: " << seconds << " s\n";
+    if (seconds > 0)
+        std::cout << "Throughput: " << (long long)(accesses / seconds) << " accesses/s\n";
+    cache.stats();
+    return 0;
+}
@@ -1,18 +1,151 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "../include/memory.h"
 #include "../include/allocator.h"
 #include "../include/cache.h"
+#include "../include/trace.h"
+#include "../include/mrc.h"
+#include "../include/coherence.h"
+#include "../include/vm.h"
+#include "../include/metrics.h"
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "--replay" && argc >= 3) {
+        std::string metricsPath;
+        int interval = 1000;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "--metrics")
+                metricsPath = argv[i + 1];
+            else if (option == "--interval")
+                interval = atoi(argv[i + 1]);
+        }
+        return replayTrace(argv[2], metricsPath, interval);
+
+    } else if (mode == "--convert" && argc == 4) {
+        size_t written = 0;
+        std::string error;
+        if (!convertTrace(argv[2], argv[3], written, error)) {
+            std::cout << "Conversion failed: " << error << "\n";
+            return 1;
+        }
+        std::cout << "Wrote " << written << " records to " << argv[3] << "\n";
+        return 0;
+
+    } else if (mode == "--mrc" && argc >= 3) {
+        double rate = 1.0;
+        int lineSize = 1;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "--sample")
+                rate = atof(argv[i + 1]);
+            else if (option == "--line")
+                lineSize = atoi(argv[i + 1]);
+        }
+        return analyzeMissRatio(argv[2], rate, lineSize);
+
+    } else if (mode == "--multicore" && argc >= 3) {
+        int cores = 4, threads = 1, epoch = 100;
+        std::string l1 = "64x8x64", l2 = "512x16x64", policy = "lru";
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "--cores")
+                cores = atoi(argv[i + 1]);
+            else if (option == "--threads")
+                threads = atoi(argv[i + 1]);
+            else if (option == "--epoch")
+                epoch = atoi(argv[i + 1]);
+            else if (option == "--l1")
+                l1 = argv[i + 1];
+            else if (option == "--l2")
+                l2 = argv[i + 1];
+            else if (option == "--policy")
+                policy = argv[i + 1];
+        }
+        return runMultiCore(argv[2], cores, l1, l2, policy, threads, epoch);
+
+    } else if (mode == "--compare" && argc >= 3) {
+        std::vector<std::string> strategies = {"first_fit", "best_fit", "worst_fit", "buddy", "tlsf"};
+        std::vector<MemSize> heaps = {0};
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            std::stringstream list(argv[i + 1]);
+            std::string item;
+            if (option == "--strategies") {
+                strategies.clear();
+                while (getline(list, item, ','))
+                    strategies.push_back(item);
+            } else if (option == "--heaps") {
+                heaps.clear();
+                MemSize heap;
+                while (getline(list, item, ','))
+                    if (parseMemSize(item, heap))
+                        heaps.push_back(heap);
+            } else if (option == "--threads") {
+                threads = atoi(argv[i + 1]);
+            }
+        }
+        return compareStrategies(argv[2], strategies, heaps, threads);
+
+    } else if (mode == "--vm" && argc >= 3) {
+        std::string args = "64 4096", extra, cacheSpec;
+        MemSize memory = 1 << 20;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "--frames")
+                args = std::string(argv[i + 1]) + args.substr(args.find(' '));
+            else if (option == "--page")
+                args = args.substr(0, args.find(' ') + 1) + argv[i + 1];
+            else if (option == "--levels" || option == "--tlb" || option == "--policy")
+                extra += std::string(" ") + argv[i + 1];
+            else if (option == "--huge")
+                extra += std::string(" ") + (std::string(argv[i + 1]) == "on" ? "huge" : "");
+            else if (option == "--memory")
+                parseMemSize(argv[i + 1], memory);
+            else if (option == "--cache")
+                cacheSpec = argv[i + 1];
+        }
+
+        std::stringstream ss(args + extra);
+        VmConfig config;
+        std::string error;
+        if (!parseVmConfig(ss, config, error)) {
+            std::cout << error << "\n";
+            return 1;
+        }
+        return runVmTrace(argv[2], config, memory, cacheSpec);
+
+    } else if (!mode.empty()) {
+        std::cout << "Usage: memsim [--replay trace.bin [--metrics out.csv] [--interval n]"
+                  << " | --convert commands.txt trace.bin"
+                  << " | --mrc trace.bin [--sample rate] [--line size]"
+                  << " | --compare commands.txt [--strategies a,b] [--heaps n,n] [--threads n]"
+                  << " | --multicore trace.txt [--cores n] [--threads n] [--epoch n]"
+                  << " [--l1 geometry] [--l2 geometry] [--policy name]"
+                  << " | --vm trace.txt [--frames n] [--page size] [--levels bits,bits]"
+                  << " [--tlb SxW] [--policy name] [--huge on] [--memory size] [--cache spec]]\n";
+        return 1;
+    }
+
     Memory mem;
     Allocator alloc;
+    ConsoleListener console;
+    alloc.setListener(&console);
+    MetricsRecorder metrics;
 
 
     TwoLevelCache* cache = nullptr;
+    VirtualMemory* vm = nullptr;
 
     std::string line;
 
@@ -27,37 +160,79 @@ int main() {
         ss >> command;
 
         if (command == "init") {
-            std::string word;
-            int size;
-            ss >> word >> size;  
-            mem.init(size);
+            std::string word, text, mode;
+            MemSize size = 0;
+            ss >> word >> text >> mode;
+            parseMemSize(text, size);
+            bool backed = mode == "backed";
+            if (!mem.init(size, backed))
+                std::cout << "Could not map " << size << " bytes of backing memory\n";
+            else if (backed)
+                std::cout << "Memory initialized with size " << size << " (backed)\n";
+            else
+                std::cout << "Memory initialized with size " << size << "\n";
 
         } else if (command == "malloc") {
-            int size;
-            ss >> size;
-            alloc.mallocMemory(mem, size);
+            std::string text;
+            MemSize size = 0;
+            ss >> text;
+            parseMemSize(text, size);
+            metrics.allocate(alloc, mem, size);
 
         } else if (command == "free") {
             int id;
             ss >> id;
-            alloc.freeBlock(mem, id);
+            metrics.release(alloc, mem, id);
 
         } else if (command == "dump") {
             mem.dump();
 
         } else if (command == "stats") {
             mem.printStats();
+            alloc.printSlabStats(mem);
+            alloc.printCompactionStats();
+
+        } else if (command == "compact") {
+            std::string text;
+            MemSize size = 0;
+            ss >> text;
+            parseMemSize(text, size);
+
+            CompactionResult result;
+            if (mem.isBuddyManaged()) {
+                std::cout << "Compaction failed: memory is managed by the buddy allocator\n";
+            } else if (!alloc.compact(mem, size, result)) {
+                if (size > 0)
+                    std::cout << "Compaction failed: only " << mem.getStats().freeMemory
+                              << " bytes free\n";
+                else
+                    std::cout << "Nothing to compact\n";
+            } else {
+                Block hole = mem.getBlock(result.hole);
+                std::cout << "Compacted: moved " << result.blocksMoved << " blocks ("
+                          << result.bytesMoved << " bytes), free block of " << hole.size
+                          << " bytes at 0x" << std::hex << hole.start << std::dec << "\n";
+            }
 
         } else if (command == "set") {
             std::string word, type;
             ss >> word >> type;
 
-            if (type == "first_fit")
-                alloc.setAllocator(FIRST_FIT);
-            else if (type == "best_fit")
-                alloc.setAllocator(BEST_FIT);
-            else if (type == "worst_fit")
-                alloc.setAllocator(WORST_FIT);
+            if (word == "slab") {
+                alloc.setSlab(type == "on");
+                std::cout << "Slab allocator " << (type == "on" ? "enabled" : "disabled") << "\n";
+                continue;
+            }
+            if (word == "compact") {
+                alloc.setAutoCompact(type == "on");
+                std::cout << "Compaction on failed malloc " << (type == "on" ? "enabled" : "disabled")
+                          << "\n";
+                continue;
+            }
+
+            AllocatorType parsed;
+            if (parseAllocatorType(type, parsed))
+                alloc.setAllocator(parsed);
 
             std::cout << "Allocator changed\n";
 
@@ -66,16 +241,19 @@ int main() {
             ss >> subcmd;
 
             if (subcmd == "init") {
-                int l1Size, l2Size;
-                ss >> l1Size >> l2Size;
+                CacheConfig config;
+                std::string error;
+                if (!parseCacheConfig(ss, config, error)) {
+                    std::cout << error << "\n";
+                    continue;
+                }
 
                 if (cache) {
                     delete cache;
                 }
 
-                cache = new TwoLevelCache(l1Size, l2Size);
-                std::cout << "Cache initialized (L1=" << l1Size
-                        << ", L2=" << l2Size << ")\n";
+                cache = new TwoLevelCache(config);
+                std::cout << "Cache initialized (" << describeCacheConfig(config) << ")\n";
 
             } else if (subcmd == "access") {
                 if (!cache) {
@@ -83,10 +261,10 @@ int main() {
                     continue;
                 }
 
-                int address;
+                MemAddr address = 0;
                 ss >> address;
 
-                int value = cache->get(address);
+                int value = metrics.get(*cache, address, mem);
                 if (value == -1)
                     std::cout << "L1 MISS -> L2 MISS -> MEMORY ACCESS\n";
                 else
@@ -98,7 +276,8 @@ int main() {
                     continue;
                 }
 
-                int address, value;
+                MemAddr address = 0;
+                int value = 0;
                 ss >> address >> value;
 
                 cache->put(address, value);
@@ -123,6 +302,128 @@ int main() {
                 std::cout << "Unknown cache command\n";
             }
 
+        } else if (command == "vm") {
+            std::string subcmd;
+            ss >> subcmd;
+
+            if (subcmd == "init") {
+                VmConfig config;
+                std::string error;
+                if (!parseVmConfig(ss, config, error)) {
+                    std::cout << error << "\n";
+                    continue;
+                }
+                if (config.policy == PAGE_OPT) {
+                    std::cout << "OPT replacement needs the whole trace (memsim --vm)\n";
+                    continue;
+                }
+
+                if (vm) {
+                    delete vm;
+                }
+
+                vm = new VirtualMemory(config, mem, alloc);
+                std::cout << "Virtual memory initialized (" << describeVmConfig(config) << ")\n";
+
+            } else if (!vm) {
+                std::cout << "Virtual memory not initialized\n";
+
+            } else if (subcmd == "access") {
+                int pid;
+                std::string addr, op;
+                ss >> pid >> addr >> op;
+                uint64_t vaddr = strtoull(addr.c_str(), nullptr, 0);
+
+                Translation t = vm->access(pid, vaddr, op == "w");
+                std::cout << "pid " << pid << ": " << addr << " -> ";
+                if (t.outOfRange) {
+                    std::cout << "outside the address space\n";
+                    continue;
+                }
+                if (t.physical == -1) {
+                    std::cout << "PAGE FAULT, no frame available\n";
+                    continue;
+                }
+
+                std::cout << t.physical;
+                if (t.tlbHit)
+                    std::cout << " (TLB hit)\n";
+                else if (!t.pageFault)
+                    std::cout << " (TLB miss)\n";
+                else if (t.evicted)
+                    std::cout << " (PAGE FAULT, evicted pid " << t.victimPid << " page 0x"
+                              << std::hex << t.victimPage << std::dec << ")\n";
+                else
+                    std::cout << " (PAGE FAULT)\n";
+
+                // The physical address then goes through the cache hierarchy
+                if (cache) {
+                    int value = cache->get(t.physical);
+                    if (value == -1)
+                        std::cout << "L1 MISS -> L2 MISS -> MEMORY ACCESS\n";
+                    else
+                        std::cout << "Cache HIT, value = " << value << "\n";
+                }
+
+            } else if (subcmd == "free") {
+                int pid;
+                ss >> pid;
+                if (vm->freeProcess(pid))
+                    std::cout << "Process " << pid << " freed\n";
+                else
+                    std::cout << "No such process\n";
+
+            } else if (subcmd == "display") {
+                int pid = -1;
+                ss >> pid;
+                vm->display(pid);
+
+            } else if (subcmd == "stats") {
+                vm->printStats();
+
+            } else {
+                std::cout << "Unknown vm command\n";
+            }
+
+        } else if (command == "metrics") {
+            std::string subcmd;
+            ss >> subcmd;
+
+            if (subcmd == "interval") {
+                int n = 0;
+                ss >> n;
+                if (n <= 0) {
+                    std::cout << "Interval must be positive\n";
+                    continue;
+                }
+                metrics.setInterval(n);
+                std::cout << "Sampling every " << n << " operations\n";
+
+            } else if (subcmd == "export") {
+                std::string path, error;
+                ss >> path;
+                if (path.empty() || !metrics.exportCsv(path, error)) {
+                    std::cout << (path.empty() ? "Missing file name" : error) << "\n";
+                    continue;
+                }
+                std::cout << "Exporting " << metrics.getSamples().size()
+                          << " samples to " << path << "\n";
+
+            } else if (subcmd == "sample") {
+                metrics.sample(mem);
+                std::cout << "Sample " << metrics.getSamples().size() << " taken\n";
+
+            } else if (subcmd == "stop") {
+                metrics.close();
+                std::cout << "Metrics export stopped\n";
+
+            } else if (subcmd == "show") {
+                metrics.print();
+
+            } else {
+                std::cout << "Unknown metrics command\n";
+            }
+
         }else if (command == "exit") {
             std::cout << "Exiting simulator...\n";
             break;
@@ -134,5 +435,8 @@ int main() {
     if(cache){
         delete cache;
     }
+    if (vm) {
+        delete vm;
+    }
     return 0;
 }
@@ -1,27 +1,137 @@
 #include "../include/memory.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+bool parseMemSize(const std::string &text, MemSize &out) {
+    char *end = nullptr;
+    errno = 0;
+    long long value = std::strtoll(text.c_str(), &end, 10);
+    if (end == text.c_str() || errno == ERANGE)
+        return false;
+
+    int shift = 0;
+    switch (*end) {
+    case 'K': case 'k': shift = 10; end++; break;
+    case 'M': case 'm': shift = 20; end++; break;
+    case 'G': case 'g': shift = 30; end++; break;
+    case 'T': case 't': shift = 40; end++; break;
+    default: break;
+    }
+    if (*end != '\0')
+        return false;
+    if (value > std::numeric_limits<MemSize>::max() >> shift ||
+        value < std::numeric_limits<MemSize>::min() >> shift)
+        return false;
+
+    out = value * ((MemSize)1 << shift);
+    return true;
+}
 
 Memory::Memory() {
     totalSize = 0;
+    backing = nullptr;
+    backingLength = 0;
+    generation = 0;
+    layoutVersion = 0;
+    lastScanned = 0;
+    activeIndexes = 0;
+    buddyManaged = false;
+    freeBytes = 0;
+    freeBlockCount = 0;
+    wastedBytes = 0;
+}
+
+Memory::~Memory() {
+    unmapBacking();
 }
 
-void Memory::init(int size) {
+bool Memory::init(MemSize size, bool backed) {
+    unsigned char *region = nullptr;
+    if (backed) {
+#ifndef _WIN32
+        void *p = MAP_FAILED;
+        if (size > 0 && (unsigned long long)size <= SIZE_MAX)
+            p = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED)
+            return false;
+        region = (unsigned char *)p;
+#else
+        return false;
+#endif
+    }
+
+    unmapBacking();
+    backing = region;
+    backingLength = backed ? (size_t)size : 0;
+
     totalSize = size;
+    generation++;
+    resetLayout();
+    return true;
+}
+
+void Memory::unmapBacking() {
+#ifndef _WIN32
+    if (backing)
+        munmap(backing, backingLength);
+#endif
+    backing = nullptr;
+    backingLength = 0;
+}
+
+bool Memory::isBacked() const {
+    return backing != nullptr;
+}
+
+void *Memory::pointerAt(MemAddr address) const {
+    if (!backing || address < 0 || (unsigned long long)address >= backingLength)
+        return nullptr;
+    return backing + address;
+}
+
+void Memory::clearLayout() {
     blocks.clear();
+    freeByAddress.clear();
+    freeBySize.clear();
+    freeByClass.clear();
+    usedById.clear();
+    buddyFree.clear();
+    buddyManaged = false;
+    freeBytes = 0;
+    freeBlockCount = 0;
+    wastedBytes = 0;
+    freeSizeCounts.clear();
+}
 
-    Block initial;
-    initial.start = 0;
-    initial.size = size;
-    initial.free = true;
-    initial.id = -1;
+// One free block spanning the whole memory
+void Memory::resetLayout() {
+    clearLayout();
+    addFreeBlock(0, totalSize);
+}
 
-    blocks.push_back(initial);
+void Memory::addFreeBlock(MemAddr start, MemSize size) {
+    Block block;
+    block.start = start;
+    block.size = size;
+    block.free = true;
+    block.id = -1;
+    block.requested = 0;
 
-    std::cout << "Memory initialized with size " << size << "\n";
+    indexFree(blocks.insertBefore(BlockTable::NONE, block));
 }
 
 void Memory::dump() {
     std::cout << "----- Memory Dump -----\n";
-    for (auto &b : blocks) {
+    for (BlockRef s = blocks.first(); s != BlockTable::NONE; s = blocks.next(s)) {
+        Block b = blocks.get(s);
         std::cout << "[0x"
                   << std::hex << b.start
                   << " - 0x"
@@ -30,46 +140,500 @@ void Memory::dump() {
 
         if (b.free) {
             std::cout << "FREE\n";
+        } else if (b.id < -1) {
+            std::cout << "USED (internal)\n";
         } else {
             std::cout << "USED (id=" << b.id << ")\n";
         }
     }
 }
 
-int Memory::getTotalSize() {
+MemSize Memory::getTotalSize() {
     return totalSize;
 }
 
-std::list<Block>& Memory::getBlocks() {
+int Memory::getGeneration() const {
+    return generation;
+}
+
+int Memory::getLayoutVersion() const {
+    return layoutVersion;
+}
+
+int Memory::getLastScanned() const {
+    return lastScanned;
+}
+
+const BlockTable& Memory::getBlocks() const {
     return blocks;
 }
 
+Block Memory::getBlock(BlockRef block) const {
+    return blocks.get(block);
+}
+
+// Shared by getStats and scanStats so both round the same way
+static MemoryStats makeStats(MemSize totalSize, MemSize usedMemory, MemSize freeMemory,
+                             MemSize largestFree, int blockCount, int freeBlocks, MemSize wasted) {
+    MemoryStats stats;
+    stats.totalMemory = totalSize;
+    stats.usedMemory = usedMemory;
+    stats.freeMemory = freeMemory;
+    stats.largestFree = largestFree;
+    stats.blockCount = blockCount;
+    stats.freeBlocks = freeBlocks;
+
+    stats.externalFragmentation = 0.0;
+    if (freeMemory > 0)
+        stats.externalFragmentation = 100.0 * (1.0 - (double)largestFree / freeMemory);
+
+    stats.internalFragmentation = 0.0;
+    if (usedMemory > 0)
+        stats.internalFragmentation = 100.0 * ((double)wasted / usedMemory);
+
+    stats.utilization = 100.0 * ((double)usedMemory / totalSize);
+    return stats;
+}
+
+MemoryStats Memory::getStats() const {
+    MemSize largestFree = freeSizeCounts.empty() ? 0 : freeSizeCounts.rbegin()->first;
+    return makeStats(totalSize, totalSize - freeBytes, freeBytes, largestFree,
+                     blocks.size(), freeBlockCount, wastedBytes);
+}
+
+const std::map<MemSize, int> &Memory::getFreeSizeCounts() const {
+    return freeSizeCounts;
+}
+
+MemoryStats Memory::scanStats() const {
+    MemSize usedMemory = 0;
+    MemSize freeMemory = 0;
+    MemSize largestFree = 0;
+    int freeBlocks = 0;
+    MemSize wasted = 0;
+
+    // Order does not matter here, so walk the arrays directly
+    for (BlockRef s = 0; s < blocks.capacity(); s++) {
+        if (!blocks.isLive(s))
+            continue;
+
+        MemSize size = blocks.blockSize(s);
+        if (blocks.isFree(s)) {
+            freeMemory += size;
+            freeBlocks++;
+            if (size > largestFree) largestFree = size;
+        } else {
+            usedMemory += size;
+            wasted += size - blocks.requested(s);
+        }
+    }
+
+    return makeStats(totalSize, usedMemory, freeMemory, largestFree, blocks.size(),
+                     freeBlocks, wasted);
+}
+
 void Memory::printStats() {
-    int usedMemory = 0;
-    int freeMemory = 0;
-    int largestFree = 0;
+    MemoryStats stats = getStats();
 
-    for (auto &b : blocks) {
-        if (b.free) {
-            freeMemory += b.size;
-            if (b.size > largestFree) largestFree = b.size;
+    std::cout << "----- Memory Stats -----\n";
+    std::cout << "Total memory: " << stats.totalMemory << "\n";
+    std::cout << "Used memory: " << stats.usedMemory << "\n";
+    std::cout << "Free memory: " << stats.freeMemory << "\n";
+    std::cout << "Memory utilization: " << stats.utilization << "%\n";
+    std::cout << "External fragmentation: " << stats.externalFragmentation << "%\n";
+    std::cout << "Internal fragmentation: " << stats.internalFragmentation << "%\n";
+}
+
+void Memory::useIndex(FreeIndexKind kind) {
+    if (activeIndexes & kind)
+        return;
+
+    activeIndexes |= kind;
+    for (BlockRef s = blocks.first(); s != BlockTable::NONE; s = blocks.next(s)) {
+        if (!blocks.isFree(s))
+            continue;
+
+        if (kind == ADDRESS_INDEX)
+            freeByAddress.insert(blocks.start(s), blocks.blockSize(s), s);
+        else if (kind == SIZE_INDEX)
+            freeBySize[std::make_pair(blocks.blockSize(s), blocks.start(s))] = s;
+        else
+            freeByClass.insert(s, blocks.blockSize(s));
+    }
+}
+
+// Every free block is indexed here once it has its final size and
+// unindexed before it changes, so the free totals follow along
+void Memory::indexFree(BlockRef block) {
+    MemAddr start = blocks.start(block);
+    MemSize size = blocks.blockSize(block);
+
+    freeBytes += size;
+    freeBlockCount++;
+    freeSizeCounts[size]++;
+
+    if (activeIndexes & ADDRESS_INDEX)
+        freeByAddress.insert(start, size, block);
+    if (activeIndexes & SIZE_INDEX)
+        freeBySize[std::make_pair(size, start)] = block;
+    if (activeIndexes & TLSF_INDEX)
+        freeByClass.insert(block, size);
+}
+
+void Memory::unindexFree(BlockRef block) {
+    MemSize size = blocks.blockSize(block);
+    freeBytes -= size;
+    freeBlockCount--;
+    auto count = freeSizeCounts.find(size);
+    if (--count->second == 0)
+        freeSizeCounts.erase(count);
+
+    if (activeIndexes & ADDRESS_INDEX)
+        freeByAddress.erase(blocks.start(block));
+    if (activeIndexes & SIZE_INDEX)
+        freeBySize.erase(std::make_pair(blocks.blockSize(block), blocks.start(block)));
+    if (activeIndexes & TLSF_INDEX)
+        freeByClass.erase(block);
+}
+
+bool Memory::findFirstFit(MemSize size, BlockRef &out) {
+    useIndex(ADDRESS_INDEX);
+    return freeByAddress.findFirstFit(size, out, lastScanned);
+}
+
+bool Memory::findBestFit(MemSize size, BlockRef &out) {
+    useIndex(SIZE_INDEX);
+    lastScanned = 1;
+
+    // Smallest hole that fits, lowest address among equal sizes
+    auto it = freeBySize.lower_bound(std::make_pair(size, std::numeric_limits<MemAddr>::min()));
+    if (it == freeBySize.end())
+        return false;
+
+    out = it->second;
+    return true;
+}
+
+bool Memory::findWorstFit(MemSize size, BlockRef &out) {
+    useIndex(SIZE_INDEX);
+    lastScanned = 1;
+
+    if (freeBySize.empty())
+        return false;
+
+    MemSize largest = freeBySize.rbegin()->first.first;
+    if (largest < size)
+        return false;
+
+    // Lowest address among the largest holes
+    auto it = freeBySize.lower_bound(std::make_pair(largest, std::numeric_limits<MemAddr>::min()));
+    out = it->second;
+    return true;
+}
+
+// Slab blocks track the bytes requested by their live objects
+void Memory::adjustRequested(int id, MemSize delta) {
+    auto it = usedById.find(id);
+    if (it != usedById.end()) {
+        blocks.requested(it->second) += delta;
+        wastedBytes -= delta;
+    }
+}
+
+bool Memory::findTlsfFit(MemSize size, BlockRef &out) {
+    useIndex(TLSF_INDEX);
+    return freeByClass.findFit(size, out, lastScanned);
+}
+
+bool Memory::findById(int id, BlockRef &out) {
+    auto it = usedById.find(id);
+    if (it == usedById.end())
+        return false;
+
+    out = it->second;
+    return true;
+}
+
+BlockRef Memory::allocateFrom(BlockRef hole, MemSize size, int id) {
+    // Create allocated block
+    Block allocated;
+    allocated.start = blocks.start(hole);
+    allocated.size = size;
+    allocated.free = false;
+    allocated.id = id;
+    allocated.requested = size;
+
+    // Modify current free block
+    unindexFree(hole);
+    blocks.start(hole) += size;
+    blocks.blockSize(hole) -= size;
+
+    // Insert allocated block before free block
+    BlockRef result = blocks.insertBefore(hole, allocated);
+    usedById[id] = result;
+
+    // If free block becomes size 0, remove it
+    if (blocks.blockSize(hole) == 0)
+        blocks.erase(hole);
+    else
+        indexFree(hole);
+
+    return result;
+}
+
+void Memory::release(BlockRef block) {
+    if (buddyManaged) {
+        buddyRelease(block);
+        return;
+    }
+
+    // Mark block as free
+    wastedBytes -= blocks.blockSize(block) - blocks.requested(block);
+    usedById.erase(blocks.id(block));
+    blocks.setFree(block, true);
+    blocks.id(block) = -1;
+    blocks.requested(block) = 0;
+
+    // Merge with next block if free
+    BlockRef next = blocks.next(block);
+    if (next != BlockTable::NONE && blocks.isFree(next)) {
+        unindexFree(next);
+        blocks.blockSize(block) += blocks.blockSize(next);
+        blocks.erase(next);
+    }
+
+    // Merge with previous block if free
+    BlockRef prev = blocks.prev(block);
+    if (prev != BlockTable::NONE && blocks.isFree(prev)) {
+        unindexFree(prev);
+        blocks.blockSize(prev) += blocks.blockSize(block);
+        blocks.erase(block);
+        block = prev;
+    }
+
+    indexFree(block);
+}
+
+bool Memory::hasAllocations() const {
+    return !usedById.empty();
+}
+
+bool Memory::isBuddyManaged() const {
+    return buddyManaged;
+}
+
+bool Memory::enableBuddy() {
+    if (hasAllocations())
+        return false;
+
+    clearLayout();
+    useIndex(ADDRESS_INDEX);   // buddy blocks are looked up by address
+    buddyFree.reset(totalSize);
+    buddyManaged = true;
+
+    // Carve the heap into aligned power-of-two blocks, largest first.
+    // Whatever is left below the smallest order stays an untracked hole.
+    MemAddr start = 0;
+    for (int order = buddyFree.getMaxOrder(); order >= BuddyIndex::MIN_ORDER; order--) {
+        MemSize blockSize = (MemSize)1 << order;
+        if (totalSize - start >= blockSize) {
+            addFreeBlock(start, blockSize);
+            buddyFree.add(start, order);
+            start += blockSize;
+        }
+    }
+
+    if (start < totalSize)
+        addFreeBlock(start, totalSize - start);
+
+    return true;
+}
+
+bool Memory::disableBuddy() {
+    if (hasAllocations())
+        return false;
+
+    resetLayout();
+    return true;
+}
+
+bool Memory::buddyAllocate(MemSize size, int id, BlockRef &out) {
+    int order = BuddyIndex::orderFor(size);
+    int maxOrder = buddyFree.getMaxOrder();
+    if (size <= 0 || maxOrder < 0 || size > (MemSize)1 << maxOrder)
+        return false;
+
+    // Smallest order with a free block
+    int current = order;
+    MemAddr start = 0;
+    lastScanned = 1;
+    while (current <= maxOrder && !buddyFree.pop(current, start)) {
+        current++;
+        lastScanned++;
+    }
+
+    if (current > maxOrder)
+        return false;
+
+    BlockRef block;
+    freeByAddress.find(start, block);
+
+    // Split down, keeping the lower half and freeing the upper one
+    while (current > order) {
+        current--;
+        MemSize half = (MemSize)1 << current;
+
+        unindexFree(block);
+        blocks.blockSize(block) = half;
+        indexFree(block);
+
+        Block upper;
+        upper.start = start + half;
+        upper.size = half;
+        upper.free = true;
+        upper.id = -1;
+        upper.requested = 0;
+
+        indexFree(blocks.insertBefore(blocks.next(block), upper));
+        buddyFree.add(start + half, current);
+    }
+
+    unindexFree(block);
+    blocks.setFree(block, false);
+    blocks.id(block) = id;
+    blocks.requested(block) = size;
+    usedById[id] = block;
+    wastedBytes += blocks.blockSize(block) - size;
+
+    out = block;
+    return true;
+}
+
+void Memory::buddyRelease(BlockRef block) {
+    wastedBytes -= blocks.blockSize(block) - blocks.requested(block);
+    usedById.erase(blocks.id(block));
+    blocks.setFree(block, true);
+    blocks.id(block) = -1;
+    blocks.requested(block) = 0;
+
+    int order = BuddyIndex::orderFor(blocks.blockSize(block));
+
+    // Merge with the buddy as long as it is free at the same order
+    while (order < buddyFree.getMaxOrder()) {
+        MemAddr buddyStart = blocks.start(block) ^ ((MemAddr)1 << order);
+        if (!buddyFree.remove(buddyStart, order))
+            break;
+
+        if (buddyStart > blocks.start(block)) {
+            BlockRef next = blocks.next(block);
+            unindexFree(next);
+            blocks.blockSize(block) += blocks.blockSize(next);
+            blocks.erase(next);
         } else {
-            usedMemory += b.size;
+            BlockRef prev = blocks.prev(block);
+            unindexFree(prev);
+            blocks.blockSize(prev) += blocks.blockSize(block);
+            blocks.erase(block);
+            block = prev;
+        }
+        order++;
+    }
+
+    buddyFree.add(blocks.start(block), order);
+    indexFree(block);
+}
+
+bool Memory::compact(MemSize need, CompactionResult &out) {
+    out.blocksMoved = 0;
+    out.bytesMoved = 0;
+    out.hole = BlockTable::NONE;
+    out.moves.clear();
+
+    if (buddyManaged || need > freeBytes || freeBlockCount == 0)
+        return false;
+    if (need <= 0)
+        need = freeBytes;
+
+    // Free blocks never touch, so any window worth sliding starts and ends
+    // on a free block, and every used block inside it has to move. For
+    // each right end keep the shortest window on the left that still holds
+    // `need` free bytes; the cheapest of those is the plan.
+    BlockRef left = BlockTable::NONE, right = BlockTable::NONE;
+    MemSize bestCost = -1;
+
+    BlockRef l = BlockTable::NONE;
+    MemSize windowFree = 0, windowUsed = 0;
+    for (BlockRef r = blocks.first(); r != BlockTable::NONE; r = blocks.next(r)) {
+        if (l == BlockTable::NONE) {
+            if (!blocks.isFree(r))
+                continue;
+            l = r;
+        }
+
+        if (!blocks.isFree(r)) {
+            windowUsed += blocks.blockSize(r);
+            continue;
+        }
+        windowFree += blocks.blockSize(r);
+
+        // Drop blocks from the left while the rest still holds enough
+        while (l != r && windowFree - blocks.blockSize(l) >= need) {
+            windowFree -= blocks.blockSize(l);
+            l = blocks.next(l);
+            while (!blocks.isFree(l)) {
+                windowUsed -= blocks.blockSize(l);
+                l = blocks.next(l);
+            }
+        }
+
+        if (windowFree >= need && (bestCost == -1 || windowUsed < bestCost)) {
+            bestCost = windowUsed;
+            left = l;
+            right = r;
         }
     }
 
-    int total = totalSize;
+    if (left == BlockTable::NONE)
+        return false;
 
-    double externalFrag = 0.0;
-    if (freeMemory > 0)
-        externalFrag = 100.0 * (1.0 - (double)largestFree / freeMemory);
+    // Slide the used blocks in the window down to its start, dropping the
+    // free blocks between them, then put one free block after the last
+    MemAddr cursor = blocks.start(left);
+    MemSize merged = 0;
+    BlockRef after = blocks.next(right);
+    BlockRef s = left;
+    while (s != after) {
+        BlockRef next = blocks.next(s);
+        if (blocks.isFree(s)) {
+            merged += blocks.blockSize(s);
+            unindexFree(s);
+            blocks.erase(s);
+        } else {
+            if (blocks.start(s) != cursor) {
+                // Blocks only slide down, memmove copes with the overlap
+                if (backing)
+                    std::memmove(backing + cursor, backing + blocks.start(s),
+                                 (size_t)blocks.blockSize(s));
+                blocks.start(s) = cursor;
+                out.blocksMoved++;
+                out.bytesMoved += blocks.blockSize(s);
+                out.moves.push_back(std::make_pair(blocks.id(s), cursor));
+            }
+            cursor += blocks.blockSize(s);
+        }
+        s = next;
+    }
 
-    double utilization = 100.0 * ((double)usedMemory / total);
+    Block hole;
+    hole.start = cursor;
+    hole.size = merged;
+    hole.free = true;
+    hole.id = -1;
+    hole.requested = 0;
+    out.hole = blocks.insertBefore(after, hole);
+    indexFree(out.hole);
 
-    std::cout << "----- Memory Stats -----\n";
-    std::cout << "Total memory: " << total << "\n";
-    std::cout << "Used memory: " << usedMemory << "\n";
-    std::cout << "Free memory: " << freeMemory << "\n";
-    std::cout << "Memory utilization: " << utilization << "%\n";
-    std::cout << "External fragmentation: " << externalFrag << "%\n";
+    if (out.blocksMoved > 0)
+        layoutVersion++;
+    return true;
 }
@@ -0,0 +1,287 @@
+#include "../include/metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+const int FREE_SIZE_BOUNDS[FREE_SIZE_CLASSES - 1] = {32, 128, 512, 2048, 8192, 32768, 131072};
+
+static int lastSet(unsigned long long value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = -1;
+    while (value) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+static long long nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------- LatencyHistogram ----------
+
+LatencyHistogram::LatencyHistogram() : counts((MAGNITUDES + 2) * HALF, 0) {
+    reset();
+}
+
+int LatencyHistogram::bucketOf(long long value) {
+    if (value < 2 * HALF)
+        return value < 0 ? 0 : (int)value;
+
+    int shift = lastSet((unsigned long long)value) - (SUB_BITS - 1);
+    if (shift > MAGNITUDES)
+        return (MAGNITUDES + 2) * HALF - 1;
+    return shift * HALF + (int)(value >> shift);
+}
+
+long long LatencyHistogram::highestIn(int bucket) {
+    if (bucket < 2 * HALF)
+        return bucket;
+
+    int shift = bucket / HALF - 1;
+    long long sub = bucket - shift * HALF;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(long long value, long long count) {
+    counts[bucketOf(value)] += count;
+    total += count;
+    sum += (long double)value * count;
+    if (value > maxValue)
+        maxValue = value;
+}
+
+void LatencyHistogram::add(const LatencyHistogram &other) {
+    for (size_t i = 0; i < counts.size(); i++)
+        counts[i] += other.counts[i];
+    total += other.total;
+    sum += other.sum;
+    if (other.maxValue > maxValue)
+        maxValue = other.maxValue;
+}
+
+void LatencyHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    maxValue = 0;
+    sum = 0;
+}
+
+double LatencyHistogram::mean() const {
+    return total > 0 ? (double)(sum / total) : 0.0;
+}
+
+long long LatencyHistogram::percentile(double percent) const {
+    if (total == 0)
+        return 0;
+
+    long long target = (long long)std::ceil(percent / 100.0 * total);
+    if (target < 1)
+        target = 1;
+
+    long long seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= target)
+            return std::min(highestIn(i), maxValue);
+    }
+    return maxValue;
+}
+
+// ---------- MetricsRecorder ----------
+
+MetricsRecorder::MetricsRecorder(int interval)
+    : enabled(true), interval(interval > 0 ? interval : 1000), ops(0), mallocs(0),
+      failedMallocs(0), frees(0), cacheAccesses(0), scanned(0), intervalMallocs(0) {}
+
+void MetricsRecorder::setEnabled(bool on) {
+    enabled = on;
+}
+
+bool MetricsRecorder::isEnabled() const {
+    return enabled;
+}
+
+void MetricsRecorder::setInterval(int n) {
+    if (n > 0)
+        interval = n;
+}
+
+int MetricsRecorder::getInterval() const {
+    return interval;
+}
+
+void MetricsRecorder::tick(const Memory &mem, long long count) {
+    long long before = ops / interval;
+    ops += count;
+    if (ops / interval != before)
+        sample(mem);
+}
+
+AllocResult MetricsRecorder::allocate(Allocator &alloc, Memory &mem, MemSize size) {
+    if (!enabled)
+        return alloc.allocate(mem, size);
+
+    long long begin = nowNs();
+    AllocResult r = alloc.allocate(mem, size);
+    long long ns = nowNs() - begin;
+
+    mallocLatency.record(ns);
+    mallocs++;
+    intervalMallocs++;
+    scanned += r.scanned;
+    if (r.failure != ALLOC_OK)
+        failedMallocs++;
+    tick(mem);
+    return r;
+}
+
+FreeResult MetricsRecorder::release(Allocator &alloc, Memory &mem, int id) {
+    if (!enabled)
+        return alloc.release(mem, id);
+
+    long long begin = nowNs();
+    FreeResult r = alloc.release(mem, id);
+    freeLatency.record(nowNs() - begin);
+    frees++;
+    tick(mem);
+    return r;
+}
+
+int MetricsRecorder::get(TwoLevelCache &cache, MemAddr address, const Memory &mem) {
+    if (!enabled)
+        return cache.get(address);
+
+    long long begin = nowNs();
+    int value = cache.get(address);
+    cacheLatency.record(nowNs() - begin);
+    cacheAccesses++;
+    tick(mem);
+    return value;
+}
+
+void MetricsRecorder::recordCacheBatch(long long ns, size_t n, const Memory &mem) {
+    if (!enabled || n == 0)
+        return;
+    cacheLatency.record(ns / (long long)n, n);
+    cacheAccesses += n;
+    tick(mem, n);
+}
+
+void MetricsRecorder::sample(const Memory &mem) {
+    MemoryStats stats = mem.getStats();
+
+    MetricsSample s;
+    s.ops = ops;
+    s.mallocs = mallocs;
+    s.failedMallocs = failedMallocs;
+    s.frees = frees;
+    s.cacheAccesses = cacheAccesses;
+    s.utilization = stats.totalMemory > 0 ? stats.utilization : 0.0;
+    s.externalFragmentation = stats.externalFragmentation;
+    s.freeBlocks = stats.freeBlocks;
+    s.largestFree = stats.largestFree;
+
+    // One pass over the distinct free sizes, not over the blocks
+    for (int c = 0; c < FREE_SIZE_CLASSES; c++)
+        s.freeSizes[c] = 0;
+    int c = 0;
+    for (const auto &entry : mem.getFreeSizeCounts()) {
+        while (c < FREE_SIZE_CLASSES - 1 && entry.first >= FREE_SIZE_BOUNDS[c])
+            c++;
+        s.freeSizes[c] += entry.second;
+    }
+
+    s.scannedPerMalloc = intervalMallocs > 0 ? (double)scanned / intervalMallocs : 0.0;
+    s.mallocP50 = mallocLatency.percentile(50);
+    s.mallocP99 = mallocLatency.percentile(99);
+    s.mallocMax = mallocLatency.max();
+    s.freeP50 = freeLatency.percentile(50);
+    s.freeP99 = freeLatency.percentile(99);
+    s.cacheP50 = cacheLatency.percentile(50);
+    s.cacheP99 = cacheLatency.percentile(99);
+    samples.push_back(s);
+    if (out.is_open())
+        writeRow(s);
+
+    mallocTotal.add(mallocLatency);
+    freeTotal.add(freeLatency);
+    cacheTotal.add(cacheLatency);
+    mallocLatency.reset();
+    freeLatency.reset();
+    cacheLatency.reset();
+    scanned = 0;
+    intervalMallocs = 0;
+}
+
+void MetricsRecorder::writeRow(const MetricsSample &s) {
+    out << s.ops << "," << s.mallocs << "," << s.failedMallocs << "," << s.frees << ","
+        << s.cacheAccesses << "," << s.utilization << "," << s.externalFragmentation << ","
+        << s.freeBlocks << "," << s.largestFree;
+    for (int c = 0; c < FREE_SIZE_CLASSES; c++)
+        out << "," << s.freeSizes[c];
+    out << "," << s.scannedPerMalloc << "," << s.mallocP50 << "," << s.mallocP99 << ","
+        << s.mallocMax << "," << s.freeP50 << "," << s.freeP99 << ","
+        << s.cacheP50 << "," << s.cacheP99 << "\n";
+    out.flush();
+}
+
+bool MetricsRecorder::exportCsv(const std::string &path, std::string &error) {
+    close();
+    out.open(path);
+    if (!out.is_open()) {
+        error = "cannot write " + path;
+        return false;
+    }
+
+    out << "ops,mallocs,failed_mallocs,frees,cache_accesses,utilization_pct,"
+        << "external_frag_pct,free_blocks,largest_free";
+    for (int c = 0; c < FREE_SIZE_CLASSES - 1; c++)
+        out << ",free_lt_" << FREE_SIZE_BOUNDS[c];
+    out << ",free_ge_" << FREE_SIZE_BOUNDS[FREE_SIZE_CLASSES - 2]
+        << ",scanned_per_malloc,malloc_p50_ns,malloc_p99_ns,malloc_max_ns,"
+        << "free_p50_ns,free_p99_ns,cache_p50_ns,cache_p99_ns\n";
+
+    for (const MetricsSample &s : samples)
+        writeRow(s);
+    return true;
+}
+
+void MetricsRecorder::close() {
+    if (out.is_open())
+        out.close();
+}
+
+const std::vector<MetricsSample> &MetricsRecorder::getSamples() const {
+    return samples;
+}
+
+static void printLatency(const char *name, const LatencyHistogram &h) {
+    std::cout << name << ": " << h.count() << " ops";
+    if (h.count() > 0)
+        std::cout << ", mean " << (long long)h.mean() << " ns, p50 " << h.percentile(50)
+                  << " ns, p99 " << h.percentile(99) << " ns, p99.9 " << h.percentile(99.9)
+                  << " ns, max " << h.max() << " ns";
+    std::cout << "\n";
+}
+
+void MetricsRecorder::print() const {
+    // Include the interval in progress
+    LatencyHistogram m = mallocTotal, f = freeTotal, c = cacheTotal;
+    m.add(mallocLatency);
+    f.add(freeLatency);
+    c.add(cacheLatency);
+
+    std::cout << "----- Metrics -----\n";
+    std::cout << "Operations: " << ops << " | Samples: " << samples.size()
+              << " (every " << interval << " ops)\n";
+    printLatency("malloc", m);
+    printLatency("free", f);
+    printLatency("cache access", c);
+}
@@ -0,0 +1,183 @@
+#include "../include/mrc.h"
+#include "../include/trace.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+static const uint32_t SAMPLE_MODULUS = 1 << 24;
+static const long long MIN_TREE = 1 << 16;
+
+static uint64_t mixKey(uint64_t x) {
+    // splitmix64 finalizer: spreads consecutive keys over the sample space
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+MissRatioCurve::MissRatioCurve(double sampleRate, int lineSize)
+    : tree(MIN_TREE + 1, 0), now(0), references(0), sampled(0),
+      rate(sampleRate), lineShift(0) {
+    if (rate <= 0 || rate > 1)
+        rate = 1.0;
+    threshold = (uint32_t)(rate * SAMPLE_MODULUS);
+
+    while (lineSize > 1 && (1 << (lineShift + 1)) <= lineSize)
+        lineShift++;
+}
+
+void MissRatioCurve::add(long long pos, int delta) {
+    long long n = tree.size() - 1;
+    for (; pos <= n; pos += pos & -pos)
+        tree[pos] += delta;
+}
+
+long long MissRatioCurve::prefix(long long pos) const {
+    long long sum = 0;
+    for (; pos > 0; pos -= pos & -pos)
+        sum += tree[pos];
+    return sum;
+}
+
+// Out of time slots: renumber the live keys 1..k in access order and
+// rebuild the tree with room for as many new accesses again
+void MissRatioCurve::compact() {
+    std::vector<std::pair<long long, uint64_t>> order;
+    order.reserve(lastAccess.size());
+    for (const auto &entry : lastAccess)
+        order.push_back(std::make_pair(entry.second, entry.first));
+    std::sort(order.begin(), order.end());
+
+    long long k = order.size();
+    long long size = std::max(MIN_TREE, 2 * k);
+    tree.assign(size + 1, 0);
+
+    for (long long i = 0; i < k; i++)
+        lastAccess[order[i].second] = i + 1;
+
+    // Linear-time Fenwick build over the markers at 1..k
+    for (long long pos = 1; pos <= size; pos++) {
+        if (pos <= k)
+            tree[pos] += 1;
+        long long parent = pos + (pos & -pos);
+        if (parent <= size)
+            tree[parent] += tree[pos];
+    }
+    now = k;
+}
+
+void MissRatioCurve::access(MemAddr address, bool counted) {
+    uint64_t key = (uint64_t)address >> lineShift;
+    if (counted)
+        references++;
+
+    if (rate < 1.0 && (mixKey(key) & (SAMPLE_MODULUS - 1)) >= threshold)
+        return;
+    if (counted)
+        sampled++;
+
+    if (now + 1 >= (long long)tree.size())
+        compact();
+    now++;
+
+    auto it = lastAccess.find(key);
+    if (it != lastAccess.end()) {
+        long long last = it->second;
+        long long distance = prefix(now - 1) - prefix(last);
+
+        if (counted) {
+            long long scaled = (long long)(distance / rate);
+            if (scaled >= (long long)histogram.size())
+                histogram.resize(scaled + 1, 0);
+            histogram[scaled]++;
+        }
+
+        add(last, -1);
+        it->second = now;
+    } else {
+        lastAccess[key] = now;
+    }
+    add(now, 1);
+}
+
+// An LRU cache of `capacity` entries hits exactly the accesses whose stack
+// distance is below its capacity
+double MissRatioCurve::hitRatio(long long capacity) const {
+    if (sampled == 0)
+        return 0.0;
+
+    long long hits = 0;
+    long long limit = std::min(capacity, (long long)histogram.size());
+    for (long long d = 0; d < limit; d++)
+        hits += histogram[d];
+    return (double)hits / sampled;
+}
+
+long long MissRatioCurve::distinctKeys() const {
+    return (long long)(lastAccess.size() / rate);
+}
+
+std::vector<MrcPoint> MissRatioCurve::curve() const {
+    std::vector<MrcPoint> points;
+    long long hits = 0;
+    long long d = 0;
+    long long last = std::max(distinctKeys(), (long long)histogram.size());
+
+    for (long long capacity = 1; ; capacity *= 2) {
+        for (; d < capacity && d < (long long)histogram.size(); d++)
+            hits += histogram[d];
+
+        MrcPoint point;
+        point.capacity = capacity;
+        point.hitRatio = sampled ? (double)hits / sampled : 0.0;
+        points.push_back(point);
+
+        if (capacity >= last)
+            break;
+    }
+    return points;
+}
+
+void MissRatioCurve::print() const {
+    const char *unit = lineShift > 0 ? "lines" : "entries";
+
+    std::cout << "----- Miss Ratio Curve -----\n";
+    std::cout << "References: " << references << "\n";
+    if (rate < 1.0)
+        std::cout << "Sampled: " << sampled << " (rate " << rate << ")\n";
+    if (lineShift > 0)
+        std::cout << "Line size: " << (1 << lineShift) << "\n";
+    std::cout << "Distinct " << unit << ": " << distinctKeys()
+              << (rate < 1.0 ? " (estimated)" : "") << "\n";
+
+    std::cout << std::left << std::setw(14) << "Capacity" << std::setw(12) << "Hit ratio"
+              << "Miss ratio\n";
+    std::cout << std::fixed << std::setprecision(4);
+    for (const MrcPoint &p : curve())
+        std::cout << std::setw(14) << p.capacity << std::setw(12) << p.hitRatio
+                  << 1.0 - p.hitRatio << "\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::right << std::setprecision(6);
+}
+
+int analyzeMissRatio(const std::string &path, double sampleRate, int lineSize) {
+    TraceFile trace;
+    std::string error;
+    if (!trace.open(path, error)) {
+        std::cout << "Analysis failed: " << error << "\n";
+        return 1;
+    }
+
+    MissRatioCurve mrc(sampleRate, lineSize);
+    const TraceRecord *records = trace.records();
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        if (records[i].op == TRACE_CACHE_ACCESS)
+            mrc.access(records[i].arg);
+        else if (records[i].op == TRACE_CACHE_PUT)
+            mrc.access(records[i].arg, false);
+    }
+
+    mrc.print();
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "../include/pmr_resource.h"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+AllocatorResource::AllocatorResource(Memory &memory, Allocator &allocator)
+    : mem(memory), alloc(allocator) {
+    stats.allocations = 0;
+    stats.frees = 0;
+    stats.failures = 0;
+    stats.bytesInUse = 0;
+    stats.peakBytes = 0;
+}
+
+void *AllocatorResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    // Blocks start at any byte, so reserve enough to align the pointer
+    // with the id still fitting in front of it
+    MemSize size = (MemSize)(bytes + sizeof(int) + alignment - 1);
+    AllocResult r = alloc.allocate(mem, size);
+    if (r.failure != ALLOC_OK || !r.pointer) {
+        if (r.failure == ALLOC_OK)
+            alloc.freeBlock(mem, r.id);
+        stats.failures++;
+        throw std::bad_alloc();
+    }
+
+    uintptr_t first = (uintptr_t)r.pointer + sizeof(int);
+    uintptr_t aligned = (first + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    std::memcpy((unsigned char *)aligned - sizeof(int), &r.id, sizeof(int));
+
+    stats.allocations++;
+    stats.bytesInUse += (long long)bytes;
+    if (stats.bytesInUse > stats.peakBytes)
+        stats.peakBytes = stats.bytesInUse;
+    return (void *)aligned;
+}
+
+void AllocatorResource::do_deallocate(void *p, std::size_t bytes, std::size_t) {
+    int id;
+    std::memcpy(&id, (unsigned char *)p - sizeof(int), sizeof(int));
+    alloc.freeBlock(mem, id);
+    stats.frees++;
+    stats.bytesInUse -= (long long)bytes;
+}
+
+bool AllocatorResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+const ResourceStats &AllocatorResource::getStats() const {
+    return stats;
+}
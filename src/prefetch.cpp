@@ -0,0 +1,183 @@
+#include "../include/prefetch.h"
+#include <cstdlib>
+
+PrefetchConfig defaultPrefetchConfig() {
+    PrefetchConfig config;
+    config.kind = PREFETCH_NONE;
+    config.degree = 1;
+    config.buffers = 4;
+    config.depth = 4;
+    return config;
+}
+
+static bool parseCount(const std::string &text, int max, int &value) {
+    if (text.empty() || text.size() > 4 || text.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    value = std::atoi(text.c_str());
+    return value >= 1 && value <= max;
+}
+
+bool parsePrefetchConfig(const std::string &word, PrefetchConfig &config) {
+    size_t colon = word.find(':');
+    std::string name = word.substr(0, colon);
+    std::string arg = colon == std::string::npos ? "" : word.substr(colon + 1);
+    if (colon != std::string::npos && arg.empty())
+        return false;
+
+    PrefetchConfig parsed = defaultPrefetchConfig();
+    if (name == "next-line") {
+        parsed.kind = PREFETCH_NEXT_LINE;
+    } else if (name == "stride") {
+        parsed.kind = PREFETCH_STRIDE;
+        parsed.degree = 2;
+    } else if (name == "stream") {
+        parsed.kind = PREFETCH_STREAM;
+        if (!arg.empty()) {
+            size_t x = arg.find('x');
+            if (x == std::string::npos ||
+                !parseCount(arg.substr(0, x), 64, parsed.buffers) ||
+                !parseCount(arg.substr(x + 1), 1024, parsed.depth))
+                return false;
+        }
+        config = parsed;
+        return true;
+    } else {
+        return false;
+    }
+
+    if (!arg.empty() && !parseCount(arg, 64, parsed.degree))
+        return false;
+    config = parsed;
+    return true;
+}
+
+std::string describePrefetchConfig(const PrefetchConfig &config) {
+    switch (config.kind) {
+    case PREFETCH_NEXT_LINE:
+        return "next-line:" + std::to_string(config.degree);
+    case PREFETCH_STRIDE:
+        return "stride:" + std::to_string(config.degree);
+    case PREFETCH_STREAM:
+        return "stream:" + std::to_string(config.buffers) + "x" + std::to_string(config.depth);
+    default:
+        return "none";
+    }
+}
+
+std::unique_ptr<Prefetcher> makePrefetcher(const PrefetchConfig &config) {
+    switch (config.kind) {
+    case PREFETCH_NEXT_LINE:
+        return std::unique_ptr<Prefetcher>(new NextLinePrefetcher(config.degree));
+    case PREFETCH_STRIDE:
+        return std::unique_ptr<Prefetcher>(new StridePrefetcher(config.degree));
+    case PREFETCH_STREAM:
+        return std::unique_ptr<Prefetcher>(new StreamBuffers(config.buffers, config.depth));
+    default:
+        return nullptr;
+    }
+}
+
+// ---------- Next-line ----------
+
+NextLinePrefetcher::NextLinePrefetcher(int degree) : degree(degree) {}
+
+void NextLinePrefetcher::access(uint64_t line, bool trigger, std::vector<uint64_t> &out) {
+    if (!trigger)
+        return;
+    for (int i = 1; i <= degree; i++)
+        out.push_back(line + i);
+}
+
+// ---------- Stride ----------
+
+StridePrefetcher::StridePrefetcher(int degree)
+    : degree(degree), table(TABLE_SIZE, Entry{0, 0, 0, 0, false}) {}
+
+void StridePrefetcher::access(uint64_t line, bool, std::vector<uint64_t> &out) {
+    uint64_t region = line >> REGION_SHIFT;
+    Entry &e = table[region % TABLE_SIZE];
+
+    if (!e.valid || e.region != region) {
+        e = Entry{region, line, 0, 0, true};
+        return;
+    }
+
+    long long delta = (long long)line - e.lastLine;
+    if (delta == 0)
+        return;
+
+    if (delta == e.stride) {
+        if (e.confidence < 2)
+            e.confidence++;
+    } else {
+        e.stride = delta;
+        e.confidence = 0;
+    }
+    e.lastLine = line;
+
+    if (e.confidence == 0)
+        return;
+    for (int i = 1; i <= degree; i++) {
+        long long next = (long long)line + e.stride * i;
+        if (next < 0)
+            break;
+        out.push_back((uint64_t)next);
+    }
+}
+
+// ---------- Stream buffers ----------
+
+StreamBuffers::StreamBuffers(int count, int depth)
+    : depth(depth), buffers(count), clock(0), claimed(-1) {
+    for (Buffer &b : buffers) {
+        b.nextLine = 0;
+        b.lastUse = -1;
+    }
+}
+
+void StreamBuffers::topUp(Buffer &buffer, std::vector<uint64_t> &out) {
+    while ((int)buffer.lines.size() < depth) {
+        buffer.lines.push_back(buffer.nextLine);
+        out.push_back(buffer.nextLine);
+        buffer.nextLine++;
+    }
+}
+
+bool StreamBuffers::claim(uint64_t line) {
+    for (size_t b = 0; b < buffers.size(); b++) {
+        std::vector<uint64_t> &lines = buffers[b].lines;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i] != line)
+                continue;
+
+            // Lines ahead of the one used are skipped over and dropped
+            lines.erase(lines.begin(), lines.begin() + i + 1);
+            claimed = b;
+            return true;
+        }
+    }
+    return false;
+}
+
+void StreamBuffers::access(uint64_t line, bool trigger, std::vector<uint64_t> &out) {
+    if (!trigger)
+        return;
+
+    clock++;
+    if (claimed != -1) {
+        buffers[claimed].lastUse = clock;
+        topUp(buffers[claimed], out);
+        claimed = -1;
+        return;
+    }
+
+    Buffer *lru = &buffers[0];
+    for (Buffer &b : buffers)
+        if (b.lastUse < lru->lastUse)
+            lru = &b;
+
+    lru->lines.clear();
+    lru->nextLine = line + 1;
+    lru->lastUse = clock;
+    topUp(*lru, out);
+}
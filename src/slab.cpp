@@ -0,0 +1,178 @@
+#include "../include/slab.h"
+#include <iostream>
+
+static int lowestClearBit(unsigned value) {
+#if defined(__GNUC__)
+    return __builtin_ctz(~value);
+#else
+    int bit = 0;
+    while (value & 1u) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+SlabCache::SlabCache() {
+    reset();
+}
+
+// Smallest class holding size bytes, -1 if too big for a slab
+int SlabCache::classFor(MemSize size) {
+    if (size <= 0)
+        return -1;
+
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        if (size <= classSize(c))
+            return c;
+    }
+    return -1;
+}
+
+int SlabCache::classSize(int sizeClass) {
+    return 16 << sizeClass;
+}
+
+void SlabCache::reset() {
+    slabs.clear();
+    freeSlabSlots.clear();
+    partialHead.assign(CLASS_COUNT, -1);
+    slabCount.assign(CLASS_COUNT, 0);
+    liveCount.assign(CLASS_COUNT, 0);
+    objects.clear();
+}
+
+bool SlabCache::empty() const {
+    return slabs.size() == freeSlabSlots.size();
+}
+
+bool SlabCache::owns(int objectId) const {
+    return objects.find(objectId) != objects.end();
+}
+
+void SlabCache::linkPartial(int s) {
+    Slab &slab = slabs[s];
+    slab.prevPartial = -1;
+    slab.nextPartial = partialHead[slab.sizeClass];
+    if (slab.nextPartial != -1)
+        slabs[slab.nextPartial].prevPartial = s;
+    partialHead[slab.sizeClass] = s;
+}
+
+void SlabCache::unlinkPartial(int s) {
+    Slab &slab = slabs[s];
+    if (slab.prevPartial != -1)
+        slabs[slab.prevPartial].nextPartial = slab.nextPartial;
+    else
+        partialHead[slab.sizeClass] = slab.nextPartial;
+
+    if (slab.nextPartial != -1)
+        slabs[slab.nextPartial].prevPartial = slab.prevPartial;
+}
+
+void SlabCache::addSlab(int sizeClass, int blockId, MemAddr start) {
+    Slab slab;
+    slab.blockId = blockId;
+    slab.start = start;
+    slab.sizeClass = sizeClass;
+    slab.used = 0;
+
+    int s;
+    if (!freeSlabSlots.empty()) {
+        s = freeSlabSlots.back();
+        freeSlabSlots.pop_back();
+        slabs[s] = slab;
+    } else {
+        s = (int)slabs.size();
+        slabs.push_back(slab);
+    }
+
+    slabCount[sizeClass]++;
+    linkPartial(s);
+}
+
+void SlabCache::moveSlab(int blockId, MemAddr start) {
+    // Slab block ids are never reused, so a stale free slot cannot match
+    for (Slab &slab : slabs) {
+        if (slab.blockId == blockId) {
+            slab.start = start;
+            return;
+        }
+    }
+}
+
+// Takes an object from the first partial slab of the class.
+// Returns false when the class has no partial slab.
+bool SlabCache::allocate(int sizeClass, int objectId, int requested,
+                         MemAddr &address, int &blockId) {
+    int s = partialHead[sizeClass];
+    if (s == -1)
+        return false;
+
+    Slab &slab = slabs[s];
+    int slot = lowestClearBit(slab.used);
+    slab.used |= 1u << slot;
+
+    if (slab.used == 0xFFFFFFFFu)
+        unlinkPartial(s);
+
+    ObjectRef ref;
+    ref.slab = s;
+    ref.slot = slot;
+    ref.requested = requested;
+    objects[objectId] = ref;
+    liveCount[sizeClass]++;
+
+    address = slab.start + (MemAddr)slot * classSize(sizeClass);
+    blockId = slab.blockId;
+    return true;
+}
+
+// Frees an object. slabEmpty tells the caller to hand the slab's block back.
+bool SlabCache::release(int objectId, int &requested, int &blockId, bool &slabEmpty) {
+    auto it = objects.find(objectId);
+    if (it == objects.end())
+        return false;
+
+    int s = it->second.slab;
+    Slab &slab = slabs[s];
+    bool wasFull = slab.used == 0xFFFFFFFFu;
+
+    slab.used &= ~(1u << it->second.slot);
+    requested = it->second.requested;
+    blockId = slab.blockId;
+    liveCount[slab.sizeClass]--;
+    objects.erase(it);
+
+    slabEmpty = slab.used == 0;
+    if (slabEmpty) {
+        if (!wasFull)
+            unlinkPartial(s);
+        slabCount[slab.sizeClass]--;
+        freeSlabSlots.push_back(s);
+    } else if (wasFull) {
+        linkPartial(s);
+    }
+    return true;
+}
+
+void SlabCache::printStats() const {
+    std::cout << "----- Slab Stats -----\n";
+
+    bool any = false;
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        if (slabCount[c] == 0)
+            continue;
+
+        int capacity = slabCount[c] * OBJECTS_PER_SLAB;
+        std::cout << "Class " << classSize(c) << ": "
+                  << slabCount[c] << " slabs, "
+                  << liveCount[c] << "/" << capacity << " objects ("
+                  << 100.0 * liveCount[c] / capacity << "%)\n";
+        any = true;
+    }
+
+    if (!any)
+        std::cout << "No slabs in use\n";
+}
@@ -0,0 +1,146 @@
+#include "../include/tlsf.h"
+
+TlsfIndex::TlsfIndex() {
+    clear();
+}
+
+int TlsfIndex::lastSet(unsigned long long value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = -1;
+    while (value) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+int TlsfIndex::firstSet(unsigned long long value) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(value);
+#else
+    int bit = 0;
+    while (!(value & 1ull)) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// Size class holding blocks of this size
+void TlsfIndex::mapping(long long size, int &fl, int &sl) {
+    if (size < SL_COUNT) {
+        fl = 0;
+        sl = (int)size;
+        return;
+    }
+
+    int msb = lastSet((unsigned long long)size);
+    fl = msb - SL_BITS + 1;
+    sl = (int)((size >> (msb - SL_BITS)) ^ SL_COUNT);
+}
+
+void TlsfIndex::clear() {
+    flBitmap = 0;
+    for (int fl = 0; fl < FL_COUNT; fl++) {
+        slBitmap[fl] = 0;
+        for (int sl = 0; sl < SL_COUNT; sl++)
+            heads[fl][sl] = -1;
+    }
+    nextInClass.clear();
+    prevInClass.clear();
+    linkedSize.clear();
+}
+
+void TlsfIndex::insert(BlockRef block, MemSize size) {
+    if (block >= (int)linkedSize.size()) {
+        nextInClass.resize(block + 1, -1);
+        prevInClass.resize(block + 1, -1);
+        linkedSize.resize(block + 1, -1);
+    }
+
+    int fl, sl;
+    mapping(size, fl, sl);
+
+    // Push on the front of the class list
+    int head = heads[fl][sl];
+    nextInClass[block] = head;
+    prevInClass[block] = -1;
+    if (head != -1)
+        prevInClass[head] = block;
+    heads[fl][sl] = block;
+    linkedSize[block] = size;
+
+    flBitmap |= 1ull << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfIndex::erase(BlockRef block) {
+    if (block >= (int)linkedSize.size() || linkedSize[block] == -1)
+        return;
+
+    int fl, sl;
+    mapping(linkedSize[block], fl, sl);
+
+    int prev = prevInClass[block];
+    int next = nextInClass[block];
+    if (prev != -1)
+        nextInClass[prev] = next;
+    else
+        heads[fl][sl] = next;
+    if (next != -1)
+        prevInClass[next] = prev;
+    linkedSize[block] = -1;
+
+    if (heads[fl][sl] == -1) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (!slBitmap[fl])
+            flBitmap &= ~(1ull << fl);
+    }
+}
+
+bool TlsfIndex::findFit(MemSize size, BlockRef &out, int &visited) const {
+    if (size < 0)
+        size = 0;
+    visited = 1;
+
+    // Round up to the next class boundary so any block found fits
+    MemSize rounded = size;
+    if (rounded >= SL_COUNT)
+        rounded += (1LL << (lastSet((unsigned long long)rounded) - SL_BITS)) - 1;
+
+    int fl, sl;
+    mapping(rounded, fl, sl);
+
+    if (fl < FL_COUNT) {
+        unsigned slMap = slBitmap[fl] & (~0u << sl);
+        if (!slMap) {
+            unsigned long long flMap = fl + 1 < FL_COUNT ? flBitmap & (~0ull << (fl + 1)) : 0;
+            if (flMap) {
+                fl = firstSet(flMap);
+                slMap = slBitmap[fl];
+            }
+        }
+
+        if (slMap) {
+            out = heads[fl][firstSet(slMap)];
+            return true;
+        }
+    }
+
+    // Nothing in a larger class: the head of the request's own class may
+    // still be big enough (e.g. the whole heap asked for at once)
+    mapping(size, fl, sl);
+    if (fl < FL_COUNT && heads[fl][sl] != -1) {
+        visited++;
+        BlockRef head = heads[fl][sl];
+        if (linkedSize[head] >= size) {
+            out = head;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,648 @@
+#include "../include/trace.h"
+#include "../include/memory.h"
+#include "../include/allocator.h"
+#include "../include/cache.h"
+#include "../include/metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char TRACE_MAGIC[4] = {'M', 'S', 'T', 'R'};
+static const uint32_t TRACE_VERSION = 1;
+
+TraceFile::TraceFile() {
+    data = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+TraceFile::~TraceFile() {
+    close();
+}
+
+bool TraceFile::open(const std::string &path, std::string &error) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        error = "cannot stat " + path;
+        return false;
+    }
+    length = (size_t)st.st_size;
+
+    if (length > 0) {
+        void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, length, MADV_SEQUENTIAL);
+            data = (const unsigned char *)p;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    if (!mapped) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            error = "cannot open " + path;
+            return false;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        length = buffer.size();
+    }
+
+    TraceHeader header;
+    if (length < sizeof(header)) {
+        error = path + " is not a trace file";
+        close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, TRACE_MAGIC, 4) != 0 || header.version != TRACE_VERSION) {
+        error = path + " is not a trace file";
+        close();
+        return false;
+    }
+
+    if (header.count > (length - sizeof(header)) / sizeof(TraceRecord)) {
+        error = path + " is truncated";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TraceFile::close() {
+#ifndef _WIN32
+    if (mapped)
+        munmap((void *)data, length);
+#endif
+    data = nullptr;
+    length = 0;
+    mapped = false;
+    buffer.clear();
+}
+
+const TraceRecord *TraceFile::records() const {
+    return (const TraceRecord *)(data + sizeof(TraceHeader));
+}
+
+size_t TraceFile::size() const {
+    if (!data)
+        return 0;
+
+    TraceHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    return (size_t)header.count;
+}
+
+// Geometry of one level in 32 bits: ways in the low 16, log2(sets) in the
+// next 8, and log2(lineSize) + 1 in the top 8 (0 = fully associative)
+static bool packGeometry(const CacheGeometry &geometry, uint32_t &packed) {
+    if (geometry.ways < 0 || geometry.ways > 0xffff)
+        return false;
+
+    uint32_t setBits = 0, lineBits = 0;
+    while ((1 << setBits) < geometry.sets)
+        setBits++;
+    if (geometry.lineSize > 0)
+        while ((1 << lineBits) < geometry.lineSize)
+            lineBits++;
+
+    packed = geometry.ways | (setBits << 16) |
+             ((geometry.lineSize > 0 ? lineBits + 1 : 0) << 24);
+    return true;
+}
+
+// Write and inclusion modes in one byte: bit 0 write-back, bit 1
+// no-write-allocate, bits 2-3 inclusion policy
+static int64_t packCacheModes(const CacheConfig &config) {
+    return (config.writeBack ? 1 : 0) | (config.writeAllocate ? 0 : 2) |
+           ((int)config.inclusion << 2);
+}
+
+static void unpackCacheModes(int64_t modes, CacheConfig &config) {
+    config.writeBack = (modes & 1) != 0;
+    config.writeAllocate = (modes & 2) == 0;
+    config.inclusion = (InclusionPolicy)((modes >> 2) & 3);
+}
+
+// Prefetcher in 32 bits: kind 4 bits, degree 8, buffers 8, depth 12
+static int64_t packPrefetch(const PrefetchConfig &prefetch) {
+    return (uint32_t)prefetch.kind | ((uint32_t)prefetch.degree << 4) |
+           ((uint32_t)prefetch.buffers << 12) | ((uint32_t)prefetch.depth << 20);
+}
+
+static PrefetchConfig unpackPrefetch(uint32_t packed) {
+    PrefetchConfig prefetch;
+    prefetch.kind = (PrefetchKind)(packed & 0xf);
+    prefetch.degree = (packed >> 4) & 0xff;
+    prefetch.buffers = (packed >> 12) & 0xff;
+    prefetch.depth = (packed >> 20) & 0xfff;
+    return prefetch;
+}
+
+static CacheGeometry unpackGeometry(uint32_t packed) {
+    CacheGeometry geometry;
+    geometry.ways = packed & 0xffff;
+    geometry.sets = 1 << ((packed >> 16) & 0xff);
+    uint32_t lineBits = packed >> 24;
+    geometry.lineSize = lineBits ? 1 << (lineBits - 1) : 0;
+    return geometry;
+}
+
+static bool parseCommand(const std::string &line, TraceRecord &record, PrefetchConfig &prefetch) {
+    std::stringstream ss(line);
+    std::string command;
+    ss >> command;
+
+    record.op = 0;
+    record.arg = 0;
+    record.arg2 = 0;
+
+    if (command == "init") {
+        std::string word, text, mode;
+        MemSize size = 0;
+        ss >> word >> text >> mode;
+        parseMemSize(text, size);
+        record.op = TRACE_INIT;
+        record.arg = size;
+        record.arg2 = mode == "backed" ? 1 : 0;
+
+    } else if (command == "malloc") {
+        std::string text;
+        MemSize size = 0;
+        ss >> text;
+        parseMemSize(text, size);
+        record.op = TRACE_MALLOC;
+        record.arg = size;
+
+    } else if (command == "free") {
+        int id = 0;
+        ss >> id;
+        record.op = TRACE_FREE;
+        record.arg = id;
+
+    } else if (command == "compact") {
+        std::string text;
+        MemSize size = 0;
+        ss >> text;
+        parseMemSize(text, size);
+        record.op = TRACE_COMPACT;
+        record.arg = size;
+
+    } else if (command == "set") {
+        std::string word, type;
+        ss >> word >> type;
+
+        if (word == "slab") {
+            record.op = TRACE_SET_SLAB;
+            record.arg = type == "on";
+        } else if (word == "compact") {
+            record.op = TRACE_SET_COMPACT;
+            record.arg = type == "on";
+        } else {
+            AllocatorType parsed;
+            if (!parseAllocatorType(type, parsed))
+                return false;
+            record.op = TRACE_SET_ALLOCATOR;
+            record.arg = parsed;
+        }
+
+    } else if (command == "cache") {
+        std::string subcmd;
+        ss >> subcmd;
+
+        if (subcmd == "init") {
+            CacheConfig config;
+            std::string error;
+            if (!parseCacheConfig(ss, config, error))
+                return false;
+            prefetch = config.prefetch;
+
+            if (config.l1.lineSize == 0 && config.l2.lineSize == 0) {
+                record.op = TRACE_CACHE_INIT;
+                record.arg = (int64_t)(uint32_t)config.l1.ways |
+                             ((int64_t)config.l1Policy << 32) | ((int64_t)config.l2Policy << 40) |
+                             (packCacheModes(config) << 48);
+                record.arg2 = config.l2.ways;
+                return true;
+            }
+
+            uint32_t l1, l2;
+            if (!packGeometry(config.l1, l1) || !packGeometry(config.l2, l2))
+                return false;
+
+            record.op = TRACE_CACHE_INIT_LINES;
+            record.arg = (int64_t)l1 | ((int64_t)l2 << 32);
+            record.arg2 = config.l1Policy | (config.l2Policy << 8) | (packCacheModes(config) << 16);
+            return true;
+        }
+
+        MemAddr a = 0;
+        int b = 0;
+        ss >> a >> b;
+
+        if (subcmd == "access")
+            record.op = TRACE_CACHE_ACCESS;
+        else if (subcmd == "put")
+            record.op = TRACE_CACHE_PUT;
+        else
+            return false;
+
+        record.arg = a;
+        record.arg2 = b;
+    }
+
+    return record.op != 0;
+}
+
+bool parseTraceCommand(const std::string &line, std::vector<TraceRecord> &records) {
+    TraceRecord record;
+    PrefetchConfig prefetch = defaultPrefetchConfig();
+    if (!parseCommand(line, record, prefetch))
+        return false;
+    records.push_back(record);
+
+    // The init records have no room left for a prefetcher, so it follows
+    // in a record of its own
+    if (prefetch.kind != PREFETCH_NONE) {
+        record.op = TRACE_CACHE_PREFETCH;
+        record.arg = packPrefetch(prefetch);
+        record.arg2 = 0;
+        records.push_back(record);
+    }
+    return true;
+}
+
+bool convertTrace(const std::string &textPath, const std::string &binaryPath,
+                  size_t &written, std::string &error) {
+    std::ifstream in(textPath);
+    if (!in.is_open()) {
+        error = "cannot open " + textPath;
+        return false;
+    }
+
+    std::vector<TraceRecord> records;
+    std::string line;
+    while (getline(in, line))
+        parseTraceCommand(line, records);
+
+    std::ofstream out(binaryPath, std::ios::binary);
+    if (!out.is_open()) {
+        error = "cannot write " + binaryPath;
+        return false;
+    }
+
+    TraceHeader header;
+    std::memcpy(header.magic, TRACE_MAGIC, 4);
+    header.version = TRACE_VERSION;
+    header.count = records.size();
+
+    out.write((const char *)&header, sizeof(header));
+    if (!records.empty())
+        out.write((const char *)records.data(), records.size() * sizeof(TraceRecord));
+
+    written = records.size();
+    return (bool)out;
+}
+
+int replayTrace(const std::string &path, const std::string &metricsPath, int interval) {
+    TraceFile trace;
+    std::string error;
+    if (!trace.open(path, error)) {
+        std::cout << "Replay failed: " << error << "\n";
+        return 1;
+    }
+
+    // Without a metrics file the recorder just forwards the calls
+    MetricsRecorder metrics(interval);
+    metrics.setEnabled(!metricsPath.empty());
+    if (metrics.isEnabled() && !metrics.exportCsv(metricsPath, error)) {
+        std::cout << "Replay failed: " << error << "\n";
+        return 1;
+    }
+
+    Memory mem;
+    Allocator alloc;            // no listener: replay runs silently
+    TwoLevelCache *cache = nullptr;
+    CacheConfig cacheConfig = defaultCacheConfig(0, 0);
+
+    size_t mallocs = 0, failedMallocs = 0;
+    size_t frees = 0, invalidFrees = 0;
+    size_t cacheOps = 0;
+
+    const size_t BATCH = 256;
+    MemAddr addrs[BATCH];
+    CacheResult results[BATCH];
+
+    const TraceRecord *records = trace.records();
+    size_t count = trace.size();
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < count; i++) {
+        const TraceRecord &r = records[i];
+
+        switch (r.op) {
+        case TRACE_INIT:
+            // Without room for the mapping the replay still runs unbacked
+            if (!mem.init(r.arg, r.arg2 != 0))
+                mem.init(r.arg);
+            break;
+        case TRACE_MALLOC:
+            mallocs++;
+            if (metrics.allocate(alloc, mem, r.arg).failure != ALLOC_OK)
+                failedMallocs++;
+            break;
+        case TRACE_FREE:
+            frees++;
+            if (!metrics.release(alloc, mem, (int)r.arg).ok)
+                invalidFrees++;
+            break;
+        case TRACE_SET_ALLOCATOR:
+            alloc.setAllocator((AllocatorType)r.arg);
+            break;
+        case TRACE_SET_SLAB:
+            alloc.setSlab(r.arg != 0);
+            break;
+        case TRACE_SET_COMPACT:
+            alloc.setAutoCompact(r.arg != 0);
+            break;
+        case TRACE_COMPACT: {
+            CompactionResult moved;
+            alloc.compact(mem, r.arg, moved);
+            break;
+        }
+        case TRACE_CACHE_INIT: {
+            CacheConfig config = defaultCacheConfig((int)(r.arg & 0xffffffff), r.arg2);
+            config.l1Policy = (CachePolicy)((r.arg >> 32) & 0xff);
+            config.l2Policy = (CachePolicy)((r.arg >> 40) & 0xff);
+            unpackCacheModes((r.arg >> 48) & 0xff, config);
+            cacheConfig = config;
+            delete cache;
+            cache = new TwoLevelCache(config);
+            break;
+        }
+        case TRACE_CACHE_INIT_LINES: {
+            CacheConfig config = defaultCacheConfig(0, 0);
+            config.l1 = unpackGeometry((uint32_t)r.arg);
+            config.l2 = unpackGeometry((uint32_t)(r.arg >> 32));
+            config.l1Policy = (CachePolicy)(r.arg2 & 0xff);
+            config.l2Policy = (CachePolicy)((r.arg2 >> 8) & 0xff);
+            unpackCacheModes((r.arg2 >> 16) & 0xff, config);
+            cacheConfig = config;
+            delete cache;
+            cache = new TwoLevelCache(config);
+            break;
+        }
+        case TRACE_CACHE_PREFETCH:
+            // Follows its init record directly, so the cache is still empty
+            cacheConfig.prefetch = unpackPrefetch((uint32_t)r.arg);
+            delete cache;
+            cache = new TwoLevelCache(cacheConfig);
+            break;
+        case TRACE_CACHE_ACCESS:
+            if (cache) {
+                // Hand runs of consecutive accesses to the batched path
+                size_t run = 0;
+                while (run < BATCH && i + run < count && records[i + run].op == TRACE_CACHE_ACCESS) {
+                    addrs[run] = records[i + run].arg;
+                    run++;
+                }
+                if (metrics.isEnabled()) {
+                    auto batchBegin = std::chrono::steady_clock::now();
+                    cache->getBatch(addrs, run, results);
+                    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - batchBegin).count();
+                    metrics.recordCacheBatch(ns, run, mem);
+                } else {
+                    cache->getBatch(addrs, run, results);
+                }
+                cacheOps += run;
+                i += run - 1;
+            }
+            break;
+        case TRACE_CACHE_PUT:
+            if (cache) {
+                cache->put(r.arg, r.arg2);
+                cacheOps++;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+
+    std::cout << "----- Replay Summary -----\n";
+    std::cout << "Records: " << count << "\n";
+    std::cout << "Mallocs: " << mallocs << " (failed: " << failedMallocs << ")\n";
+    std::cout << "Frees: " << frees << " (invalid: " << invalidFrees << ")\n";
+    std::cout << "Cache operations: " << cacheOps << "\n";
+    std::cout << "Elapsed: " << seconds << " s\n";
+    if (seconds > 0)
+        std::cout << "Throughput: " << (long long)(count / seconds) << " ops/s\n";
+
+    if (mem.getTotalSize() > 0)
+        mem.printStats();
+    alloc.printCompactionStats();
+    if (cache) {
+        cache->stats();
+        delete cache;
+    }
+    if (metrics.isEnabled()) {
+        metrics.sample(mem);
+        metrics.close();
+        metrics.print();
+        std::cout << "Metrics written to " << metricsPath << "\n";
+    }
+    return 0;
+}
+
+bool loadTraceRecords(const std::string &path, std::vector<TraceRecord> &records,
+                      std::string &error) {
+    char magic[4] = {0, 0, 0, 0};
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            error = "cannot open " + path;
+            return false;
+        }
+        in.read(magic, 4);
+    }
+
+    if (std::memcmp(magic, TRACE_MAGIC, 4) == 0) {
+        TraceFile trace;
+        if (!trace.open(path, error))
+            return false;
+        records.assign(trace.records(), trace.records() + trace.size());
+        return true;
+    }
+
+    std::ifstream in(path);
+    std::string line;
+    while (getline(in, line))
+        parseTraceCommand(line, records);
+    return true;
+}
+
+struct CompareResult {
+    AllocatorType strategy;
+    MemSize heapSize;           // 0 = sizes from the trace
+    size_t mallocs;
+    size_t failedMallocs;
+    size_t frees;
+    double seconds;
+    MemoryStats stats;
+    bool initialized;
+};
+
+// Replays only the allocator records with a fixed strategy. Frees name
+// block ids the way the CLI and --replay hand them out, one per successful
+// malloc, so they are released directly.
+static void replayAllocator(const std::vector<TraceRecord> &records, CompareResult &result) {
+    Memory mem;
+    Allocator alloc;
+    alloc.setAllocator(result.strategy);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (const TraceRecord &r : records) {
+        switch (r.op) {
+        case TRACE_INIT:
+            mem.init(result.heapSize > 0 ? result.heapSize : r.arg);
+            break;
+        case TRACE_MALLOC: {
+            result.mallocs++;
+            AllocResult a = alloc.allocate(mem, r.arg);
+            if (a.failure != ALLOC_OK)
+                result.failedMallocs++;
+            break;
+        }
+        case TRACE_FREE:
+            result.frees++;
+            alloc.release(mem, (int)r.arg);
+            break;
+        case TRACE_SET_SLAB:
+            alloc.setSlab(r.arg != 0);
+            break;
+        case TRACE_SET_COMPACT:
+            alloc.setAutoCompact(r.arg != 0);
+            break;
+        case TRACE_COMPACT: {
+            CompactionResult moved;
+            alloc.compact(mem, r.arg, moved);
+            break;
+        }
+        default:
+            break;              // strategy changes and cache records are ignored
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+    result.initialized = mem.getTotalSize() > 0;
+    if (result.initialized)
+        result.stats = mem.getStats();
+}
+
+int compareStrategies(const std::string &path, const std::vector<std::string> &strategies,
+                      const std::vector<MemSize> &heapSizes, int threads) {
+    std::vector<AllocatorType> types;
+    for (const std::string &name : strategies) {
+        AllocatorType type;
+        if (!parseAllocatorType(name, type)) {
+            std::cout << "Unknown allocator " << name << "\n";
+            return 1;
+        }
+        types.push_back(type);
+    }
+
+    std::vector<TraceRecord> records;
+    std::string error;
+    if (!loadTraceRecords(path, records, error)) {
+        std::cout << "Comparison failed: " << error << "\n";
+        return 1;
+    }
+
+    std::vector<CompareResult> results;
+    for (MemSize heap : heapSizes)
+        for (AllocatorType type : types)
+            results.push_back(CompareResult{type, heap, 0, 0, 0, 0.0, MemoryStats(), false});
+    if (results.empty())
+        return 0;
+
+    // Each configuration is independent: workers take the next one until
+    // none are left, sharing only the read-only records
+    threads = std::max(1, std::min(threads, (int)results.size()));
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < results.size(); i = next++)
+            replayAllocator(records, results[i]);
+    };
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool)
+        t.join();
+    auto end = std::chrono::steady_clock::now();
+
+    double total = 0.0;
+    std::cout << "----- Strategy Comparison -----\n";
+    std::cout << "Records: " << records.size() << "\n";
+    std::cout << std::left << std::setw(12) << "Strategy" << std::setw(12) << "Heap"
+              << std::setw(10) << "Mallocs" << std::setw(8) << "Failed"
+              << std::setw(10) << "Util %" << std::setw(12) << "Ext frag %"
+              << std::setw(12) << "Int frag %" << "ns/op\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const CompareResult &r : results) {
+        total += r.seconds;
+        size_t ops = r.mallocs + r.frees;
+        std::cout << std::setw(12) << allocatorTypeName(r.strategy)
+                  << std::setw(12) << (r.heapSize > 0 ? std::to_string(r.heapSize) : "trace")
+                  << std::setw(10) << r.mallocs << std::setw(8) << r.failedMallocs;
+        if (r.initialized)
+            std::cout << std::setw(10) << r.stats.utilization
+                      << std::setw(12) << r.stats.externalFragmentation
+                      << std::setw(12) << r.stats.internalFragmentation;
+        else
+            std::cout << std::setw(10) << "-" << std::setw(12) << "-" << std::setw(12) << "-";
+        std::cout << (ops > 0 ? r.seconds * 1e9 / ops : 0.0) << "\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::right << std::setprecision(6);
+
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    std::cout << "Elapsed: " << seconds << " s on " << threads << " threads"
+              << " (replays took " << total << " s in total)\n";
+    return 0;
+}
@@ -0,0 +1,601 @@
+#include "../include/vm.h"
+#include "../include/cache.h"
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static int log2Of(long long n) {
+    int shift = 0;
+    while ((1LL << shift) < n)
+        shift++;
+    return shift;
+}
+
+static bool isPowerOfTwo(long long n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+const char *pageReplacementName(PageReplacement policy) {
+    switch (policy) {
+    case PAGE_FIFO:
+        return "FIFO";
+    case PAGE_CLOCK:
+        return "CLOCK";
+    case PAGE_OPT:
+        return "OPT";
+    default:
+        return "LRU";
+    }
+}
+
+static bool parseLevels(const std::string &word, std::vector<int> &levels) {
+    std::vector<int> parsed;
+    std::stringstream ss(word);
+    std::string part;
+    while (getline(ss, part, ',')) {
+        if (part.empty() || part.size() > 2 || part.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        int bits = atoi(part.c_str());
+        if (bits < 1 || bits > 20)
+            return false;
+        parsed.push_back(bits);
+    }
+    if (parsed.empty() || parsed.size() > 5)
+        return false;
+    levels = parsed;
+    return true;
+}
+
+bool parseVmConfig(std::istream &args, VmConfig &config, std::string &error) {
+    VmConfig parsed;
+    parsed.levelBits = {10, 10};
+    parsed.tlbSets = 16;
+    parsed.tlbWays = 4;
+    parsed.policy = PAGE_LRU;
+    parsed.hugePages = false;
+
+    error = "Invalid VM configuration";
+    if (!(args >> parsed.frames >> parsed.pageSize) || parsed.frames < 1 ||
+        parsed.frames > 1 << 20 || !isPowerOfTwo(parsed.pageSize) || parsed.pageSize < 16)
+        return false;
+
+    std::string word;
+    while (args >> word) {
+        size_t x = word.find('x');
+        if (word == "fifo") {
+            parsed.policy = PAGE_FIFO;
+        } else if (word == "lru") {
+            parsed.policy = PAGE_LRU;
+        } else if (word == "clock") {
+            parsed.policy = PAGE_CLOCK;
+        } else if (word == "opt") {
+            parsed.policy = PAGE_OPT;
+        } else if (word == "huge") {
+            parsed.hugePages = true;
+        } else if (x != std::string::npos) {
+            int sets = atoi(word.substr(0, x).c_str());
+            int ways = atoi(word.substr(x + 1).c_str());
+            if (!isPowerOfTwo(sets) || sets > 4096 || ways < 1 || ways > 64)
+                return false;
+            parsed.tlbSets = sets;
+            parsed.tlbWays = ways;
+        } else if (!parseLevels(word, parsed.levelBits)) {
+            error = "Unknown VM option " + word;
+            return false;
+        }
+    }
+
+    int bits = log2Of(parsed.pageSize);
+    for (int b : parsed.levelBits)
+        bits += b;
+    if (bits > 48) {
+        error = "Virtual address space too large (at most 48 bits)";
+        return false;
+    }
+    if (parsed.hugePages) {
+        long long huge = (long long)parsed.pageSize << parsed.levelBits.back();
+        if (parsed.levelBits.size() < 2 || huge > INT_MAX / 2) {
+            error = "Huge pages need two or more levels and a page under 1 GB";
+            return false;
+        }
+    }
+
+    config = parsed;
+    return true;
+}
+
+std::string describeVmConfig(const VmConfig &config) {
+    std::string levels;
+    for (size_t i = 0; i < config.levelBits.size(); i++)
+        levels += (i ? "," : "") + std::to_string(config.levelBits[i]);
+
+    std::string text = std::to_string(config.frames) + " frames of " +
+                       std::to_string(config.pageSize) + " B, levels " + levels +
+                       ", TLB " + std::to_string(config.tlbSets) + "x" +
+                       std::to_string(config.tlbWays) + ", " + pageReplacementName(config.policy);
+    if (config.hugePages)
+        text += ", huge pages of " +
+                std::to_string((long long)config.pageSize << config.levelBits.back()) + " B";
+    return text;
+}
+
+VirtualMemory::VirtualMemory(const VmConfig &config, Memory &mem, Allocator &alloc)
+    : config(config), mem(mem), alloc(alloc), memoryGeneration(mem.getGeneration()) {
+    offsetBits = log2Of(config.pageSize);
+    addressBits = offsetBits;
+    for (int b : config.levelBits)
+        addressBits += b;
+
+    // A huge page covers what a last-level table would have mapped, so the
+    // walk stops one level early
+    levels = config.levelBits.size();
+    if (config.hugePages) {
+        offsetBits += config.levelBits.back();
+        levels--;
+    }
+    pageBytes = 1 << offsetBits;
+    optimal = config.policy == PAGE_OPT;
+    nextUse = LLONG_MAX;
+    stats = VmStats{0, 0, 0, 0, 0, 0, 0, 0, 0};
+    reset();
+}
+
+VirtualMemory::~VirtualMemory() {
+    checkGeneration();
+    for (const Frame &f : frames)
+        if (f.blockId != -1)
+            alloc.unreserve(mem, f.blockId);
+}
+
+// Drops every mapping. Frames whose blocks are still allocated go back to
+// the allocator unless memory was re-initialized under them.
+void VirtualMemory::reset() {
+    bool stale = mem.getGeneration() != memoryGeneration;
+    if (!stale)
+        for (const Frame &f : frames)
+            if (f.blockId != -1)
+                alloc.unreserve(mem, f.blockId);
+
+    memoryGeneration = mem.getGeneration();
+    memoryLayout = mem.getLayoutVersion();
+    processes.clear();
+    frames.clear();
+    freeFrames.clear();
+    frameNextUse.assign(config.frames, LLONG_MAX);
+    byNextUse.clear();
+
+    static const CachePolicy policies[] = {CACHE_FIFO, CACHE_LRU, CACHE_CLOCK, CACHE_LRU};
+    policy = makeReplacementPolicy(policies[config.policy], config.frames);
+
+    tlb.assign(config.tlbSets * config.tlbWays, TlbEntry{0, 0, -1, false});
+    tlbPolicies.clear();
+    for (int s = 0; s < config.tlbSets; s++)
+        tlbPolicies.push_back(makeReplacementPolicy(CACHE_LRU, config.tlbWays));
+
+    stats.tableNodes = 0;
+    stats.residentPages = 0;
+}
+
+void VirtualMemory::checkGeneration() {
+    if (mem.getGeneration() != memoryGeneration) {
+        reset();
+        return;
+    }
+
+    // Compaction moved blocks: frames keep their ids, so look up the bases
+    if (mem.getLayoutVersion() != memoryLayout) {
+        for (Frame &f : frames) {
+            BlockRef block;
+            if (f.blockId != -1 && mem.findById(f.blockId, block))
+                f.base = mem.getBlock(block).start;
+        }
+        memoryLayout = mem.getLayoutVersion();
+    }
+}
+
+int VirtualMemory::tlbLookup(int pid, uint64_t page) {
+    int set = tlbSetOf(page);
+    int base = set * config.tlbWays;
+    for (int w = 0; w < config.tlbWays; w++) {
+        const TlbEntry &e = tlb[base + w];
+        if (e.valid && e.pid == pid && e.page == page) {
+            tlbPolicies[set]->touched(w);
+            return e.frame;
+        }
+    }
+    return -1;
+}
+
+void VirtualMemory::tlbInsert(int pid, uint64_t page, int frame) {
+    int set = tlbSetOf(page);
+    int base = set * config.tlbWays;
+    MemAddr key = (MemAddr)(page >> log2Of(config.tlbSets));
+
+    int way = -1;
+    for (int w = 0; w < config.tlbWays && way == -1; w++)
+        if (!tlb[base + w].valid)
+            way = w;
+    if (way == -1) {
+        way = tlbPolicies[set]->victim(key);
+        const TlbEntry &old = tlb[base + way];
+        tlbPolicies[set]->removed(way, (MemAddr)(old.page >> log2Of(config.tlbSets)));
+    }
+
+    tlb[base + way] = TlbEntry{pid, page, frame, true};
+    tlbPolicies[set]->inserted(way, key);
+}
+
+void VirtualMemory::tlbInvalidate(int pid, uint64_t page) {
+    int set = tlbSetOf(page);
+    int base = set * config.tlbWays;
+    for (int w = 0; w < config.tlbWays; w++) {
+        TlbEntry &e = tlb[base + w];
+        if (e.valid && e.pid == pid && e.page == page) {
+            tlbPolicies[set]->removed(w, (MemAddr)(page >> log2Of(config.tlbSets)));
+            e.valid = false;
+        }
+    }
+}
+
+// Index into the table at `level` (0 = root) for a virtual page number
+int VirtualMemory::indexAt(uint64_t page, int level) const {
+    int shift = 0;
+    for (int l = levels - 1; l > level; l--)
+        shift += config.levelBits[l];
+    return (int)((page >> shift) & ((1ULL << config.levelBits[level]) - 1));
+}
+
+// Returns the leaf entry for `page`, creating missing tables if asked
+int *VirtualMemory::walk(Process &process, uint64_t page, bool create) {
+    TableNode *node = &process.root;
+    for (int level = 0; level < levels; level++) {
+        int index = indexAt(page, level);
+        int entries = 1 << config.levelBits[level];
+
+        if (level == levels - 1) {
+            if (node->frames.empty()) {
+                if (!create)
+                    return nullptr;
+                node->frames.assign(entries, -1);
+            }
+            return &node->frames[index];
+        }
+
+        if (node->children.empty()) {
+            if (!create)
+                return nullptr;
+            node->children.resize(entries);
+        }
+        if (!node->children[index]) {
+            if (!create)
+                return nullptr;
+            node->children[index].reset(new TableNode());
+            process.nodes++;
+            stats.tableNodes++;
+        }
+        node = node->children[index].get();
+    }
+    return nullptr;
+}
+
+void VirtualMemory::touchFrame(int frame, bool inserted) {
+    if (optimal) {
+        byNextUse.erase({frameNextUse[frame], frame});
+        frameNextUse[frame] = nextUse;
+        byNextUse.insert({nextUse, frame});
+    } else if (inserted) {
+        policy->inserted(frame, frame);
+    } else {
+        policy->touched(frame);
+    }
+}
+
+// Unmaps the page held in `frame`, keeping its block for reuse
+void VirtualMemory::evict(int frame) {
+    Frame &f = frames[frame];
+    auto it = processes.find(f.pid);
+    if (it != processes.end()) {
+        int *pte = walk(it->second, f.page, false);
+        if (pte)
+            *pte = -1;
+        it->second.pages--;
+    }
+    tlbInvalidate(f.pid, f.page);
+
+    if (optimal)
+        byNextUse.erase({frameNextUse[frame], frame});
+    else
+        policy->removed(frame, frame);
+
+    stats.evictions++;
+    if (f.dirty)
+        stats.dirtyEvictions++;
+    stats.residentPages--;
+    f.used = false;
+}
+
+// Unmaps `frame` and gives its block back to the allocator
+void VirtualMemory::dropFrame(int frame) {
+    Frame &f = frames[frame];
+    tlbInvalidate(f.pid, f.page);
+    if (optimal)
+        byNextUse.erase({frameNextUse[frame], frame});
+    else
+        policy->removed(frame, frame);
+
+    alloc.unreserve(mem, f.blockId);
+    f.blockId = -1;
+    f.used = false;
+    stats.residentPages--;
+    freeFrames.push_back(frame);
+}
+
+// Finds a frame for a faulting page: a new block while under the frame
+// limit and memory allows, otherwise the replacement policy's victim
+int VirtualMemory::takeFrame(Translation &t) {
+    int slot = -1;
+    if (!freeFrames.empty()) {
+        slot = freeFrames.back();
+    } else if ((int)frames.size() < config.frames) {
+        slot = frames.size();
+    }
+
+    if (slot != -1) {
+        // Frames are the simulator's own blocks, outside the user id range
+        AllocResult r = alloc.reserve(mem, pageBytes);
+
+        if (r.id != -1) {
+            if (slot == (int)frames.size())
+                frames.push_back(Frame());
+            else
+                freeFrames.pop_back();
+            frames[slot].blockId = r.id;
+            frames[slot].base = r.address;
+            return slot;
+        }
+    }
+
+    if (stats.residentPages == 0)
+        return -1;
+
+    int victim = optimal ? byNextUse.rbegin()->second : policy->victim(0);
+    t.evicted = true;
+    t.victimPid = frames[victim].pid;
+    t.victimPage = frames[victim].page;
+    evict(victim);
+    return victim;
+}
+
+void VirtualMemory::setNextUse(long long when) {
+    nextUse = when < 0 ? LLONG_MAX : when;
+}
+
+Translation VirtualMemory::access(int pid, uint64_t vaddr, bool write) {
+    checkGeneration();
+    Translation t{-1, false, false, false, false, -1, 0};
+    stats.accesses++;
+
+    if (vaddr >> addressBits) {
+        t.outOfRange = true;
+        return t;
+    }
+
+    uint64_t page = vaddr >> offsetBits;
+    int offset = (int)(vaddr & (pageBytes - 1));
+    int frame = tlbLookup(pid, page);
+
+    if (frame != -1) {
+        stats.tlbHits++;
+        t.tlbHit = true;
+        touchFrame(frame, false);
+    } else {
+        stats.tlbMisses++;
+        stats.walkSteps += levels;
+
+        Process &process = processes.emplace(pid, Process{TableNode(), 0, 0}).first->second;
+        int *pte = walk(process, page, true);
+
+        if (*pte == -1) {
+            stats.pageFaults++;
+            t.pageFault = true;
+            // Eviction only clears leaf entries, so `pte` stays valid
+            frame = takeFrame(t);
+            if (frame == -1)
+                return t;
+
+            Frame &f = frames[frame];
+            f.pid = pid;
+            f.page = page;
+            f.dirty = false;
+            f.used = true;
+            *pte = frame;
+            process.pages++;
+            stats.residentPages++;
+            touchFrame(frame, true);
+        } else {
+            frame = *pte;
+            touchFrame(frame, false);
+        }
+        tlbInsert(pid, page, frame);
+    }
+
+    if (write)
+        frames[frame].dirty = true;
+    t.physical = frames[frame].base + offset;
+    return t;
+}
+
+bool VirtualMemory::freeProcess(int pid) {
+    checkGeneration();
+    auto it = processes.find(pid);
+    if (it == processes.end())
+        return false;
+
+    for (size_t i = 0; i < frames.size(); i++)
+        if (frames[i].used && frames[i].pid == pid)
+            dropFrame(i);
+
+    stats.tableNodes -= it->second.nodes;
+    processes.erase(it);
+    return true;
+}
+
+const VmConfig &VirtualMemory::getConfig() const {
+    return config;
+}
+
+int VirtualMemory::getPageBytes() const {
+    return pageBytes;
+}
+
+VmStats VirtualMemory::getStats() const {
+    return stats;
+}
+
+void VirtualMemory::display(int pid) {
+    checkGeneration();
+    if (processes.empty()) {
+        std::cout << "No processes\n";
+        return;
+    }
+
+    for (const auto &entry : processes) {
+        if (pid != -1 && entry.first != pid)
+            continue;
+
+        std::map<uint64_t, int> mapped;
+        for (size_t i = 0; i < frames.size(); i++)
+            if (frames[i].used && frames[i].pid == entry.first)
+                mapped[frames[i].page] = i;
+
+        std::cout << "Process " << entry.first << ": " << entry.second.pages << " pages, "
+                  << entry.second.nodes + 1 << " page table nodes\n";
+        for (const auto &m : mapped) {
+            const Frame &f = frames[m.second];
+            std::cout << "  page 0x" << std::hex << m.first << " -> frame " << std::dec
+                      << m.second << " at 0x" << std::hex << f.base << std::dec
+                      << (f.dirty ? " (dirty)" : "") << "\n";
+        }
+    }
+}
+
+void VirtualMemory::printStats() const {
+    std::cout << "----- Virtual Memory Statistics -----\n";
+    std::cout << "Accesses: " << stats.accesses << "\n";
+    std::cout << "TLB Hits: " << stats.tlbHits << " | TLB Misses: " << stats.tlbMisses;
+    if (stats.tlbHits + stats.tlbMisses > 0)
+        std::cout << " (hit ratio " << 100.0 * stats.tlbHits / (stats.tlbHits + stats.tlbMisses)
+                  << "%)";
+    std::cout << "\n";
+    std::cout << "TLB Reach: " << (long long)config.tlbSets * config.tlbWays * pageBytes
+              << " B\n";
+    std::cout << "Page Walk Steps: " << stats.walkSteps << "\n";
+    std::cout << "Page Faults: " << stats.pageFaults << " | Evictions: " << stats.evictions
+              << " (dirty: " << stats.dirtyEvictions << ")\n";
+    std::cout << "Resident Pages: " << stats.residentPages << " / " << config.frames << "\n";
+    std::cout << "Page Table Nodes: " << stats.tableNodes + (long long)processes.size() << "\n";
+}
+
+struct VmAccess {
+    int pid;
+    bool write;
+    uint64_t vaddr;
+};
+
+static bool loadVmTrace(const std::string &path, std::vector<VmAccess> &accesses,
+                        std::string &error) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string line, op, addr;
+    int lineNo = 0;
+    while (getline(in, line)) {
+        lineNo++;
+        std::stringstream ss(line);
+        int pid;
+        if (!(ss >> pid))
+            continue;       // blank or comment
+
+        char *end = nullptr;
+        unsigned long long value = 0;
+        if (ss >> op >> addr)
+            value = strtoull(addr.c_str(), &end, 0);
+
+        if (!end || *end != '\0' || (op != "r" && op != "w")) {
+            error = "bad record on line " + std::to_string(lineNo);
+            return false;
+        }
+        accesses.push_back(VmAccess{pid, op == "w", value});
+    }
+    return true;
+}
+
+int runVmTrace(const std::string &path, const VmConfig &config, MemSize memorySize,
+               const std::string &cacheSpec) {
+    std::vector<VmAccess> accesses;
+    std::string error;
+    if (!loadVmTrace(path, accesses, error)) {
+        std::cout << "VM run failed: " << error << "\n";
+        return 1;
+    }
+
+    TwoLevelCache *cache = nullptr;
+    if (!cacheSpec.empty()) {
+        std::stringstream ss(cacheSpec);
+        CacheConfig cacheConfig;
+        if (!parseCacheConfig(ss, cacheConfig, error)) {
+            std::cout << error << "\n";
+            return 1;
+        }
+        cache = new TwoLevelCache(cacheConfig);
+    }
+
+    Memory mem;
+    Allocator alloc;
+    mem.init(memorySize);
+    VirtualMemory vm(config, mem, alloc);
+
+    // Belady needs to know when each page is next touched
+    std::vector<long long> next(accesses.size(), -1);
+    if (config.policy == PAGE_OPT) {
+        int shift = log2Of(vm.getPageBytes());
+        std::map<std::pair<int, uint64_t>, long long> seen;
+        for (long long i = (long long)accesses.size() - 1; i >= 0; i--) {
+            std::pair<int, uint64_t> key(accesses[i].pid, accesses[i].vaddr >> shift);
+            auto it = seen.find(key);
+            if (it != seen.end())
+                next[i] = it->second;
+            seen[key] = i;
+        }
+    }
+
+    long long unmapped = 0;
+    for (size_t i = 0; i < accesses.size(); i++) {
+        vm.setNextUse(next[i]);
+        Translation t = vm.access(accesses[i].pid, accesses[i].vaddr, accesses[i].write);
+        if (t.physical == -1) {
+            unmapped++;
+            continue;
+        }
+        if (cache) {
+            if (accesses[i].write)
+                cache->put(t.physical, (int)i);
+            else
+                cache->get(t.physical);
+        }
+    }
+
+    std::cout << "Virtual memory: " << describeVmConfig(config) << "\n";
+    std::cout << "Accesses: " << accesses.size() << " | Unmapped: " << unmapped << "\n";
+    vm.printStats();
+    if (cache) {
+        cache->stats();
+        delete cache;
+    }
+    return 0;
+}
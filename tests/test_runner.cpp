@@ -204,7 +204,7 @@ int main(int argc, char* argv[]) {
     
     cout << endl;
     cout << CYAN << "To run actual tests, use:" << RESET << endl;
-    cout << "  g++ -std=c++17 -o memsim ../src/main.cpp ../src/memory.cpp ../src/allocator.cpp ../src/cache.cpp" << endl;
+    cout << "  g++ -std=c++17 -o memsim ../src/main.cpp ../src/memory.cpp ../src/allocator.cpp ../src/address_index.cpp ../src/buddy.cpp ../src/tlsf.cpp ../src/slab.cpp ../src/block_table.cpp ../src/trace.cpp ../src/cache.cpp ../src/cache_policy.cpp ../src/prefetch.cpp ../src/mrc.cpp ../src/coherence.cpp ../src/vm.cpp ../src/metrics.cpp -pthread" << endl;
     cout << endl;
     
     return 0;